@@ -0,0 +1,410 @@
+/*
+    zlog_bench: measures the cost of a log call.
+
+    Usage: zlog_bench [--threads <n>] [--records <n>] [--sinks <null,file,console>] [--async] [--json <file>]
+
+    Every combination of sink, number of threads (1, 2, 4 ... n), colors and pattern logs the given number of
+    records per thread. The report has the ns per call, the records per second and the p50/p99/p99.9/max
+    latency of a single call. The table is written to stderr, so the console sink can be redirected,
+    and --json writes the same results to a file ("-" for stdout).
+*/
+
+#define ZLOG_IMPLEMENTATION
+#include "../src/zLog.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+    #define BENCH_NULL_DEVICE "NUL"
+#else
+    #define BENCH_NULL_DEVICE "/dev/null"
+#endif
+
+#define BENCH_FILE "zlog_bench.log"
+#define BENCH_MAX_THREADS 64
+#define BENCH_ASYNC_CAPACITY 4096
+
+typedef enum {
+    SINK_NULL,
+    SINK_FILE,
+    SINK_CONSOLE,
+    SINK_COUNT
+}BenchSink;
+
+static const char* sink_names[SINK_COUNT] = { "null", "file", "console" };
+
+static const char* bench_patterns[] = {
+    "",
+    "{t} ",
+    "{D}/{M}/{Y} {h}:{m}:{s} | {f} @ {l} | {n} | {t} > ",
+};
+
+#define BENCH_PATTERN_COUNT (sizeof(bench_patterns) / sizeof(bench_patterns[0]))
+
+/*!
+    Result of a run
+*/
+typedef struct {
+
+    BenchSink sink;
+    int threads;
+    int use_colors;
+    const char * pattern;
+    double ns_per_call;
+    double records_per_second;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+
+}BenchResult;
+
+typedef struct {
+
+    BenchSink sink;
+    size_t records;
+    uint64_t * samples;
+
+}BenchWorker;
+
+static _Atomic(int) bench_ready;
+static _Atomic(int) bench_go;
+
+static uint64_t bench_now_ns(){
+
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if(frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+
+}
+
+static ZLOG_THREAD_FN(bench_worker){
+
+    BenchWorker *worker = (BenchWorker*)arg;
+
+    atomic_fetch_add(&bench_ready, 1);
+    while(!atomic_load(&bench_go)) zlog_thread_yield();
+
+    for(size_t i = 0; i < worker->records; i++){
+
+        uint64_t start = bench_now_ns();
+
+        if(worker->sink == SINK_FILE){
+            zflog_info(BENCH_FILE, "record %zu of %s: %d %f\n", i, "bench", 42, 3.14);
+        }else {
+            zlog_info("record %zu of %s: %d %f\n", i, "bench", 42, 3.14);
+        }
+
+        worker->samples[i] = bench_now_ns() - start;
+
+    }
+
+    return 0;
+
+}
+
+static int compare_samples(const void* a, const void* b){
+
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+
+    return (x > y) - (x < y);
+
+}
+
+static uint64_t percentile(const uint64_t* sorted, size_t count, double p){
+
+    size_t index = (size_t)(p * (double)(count - 1) + 0.5);
+
+    return sorted[index];
+
+}
+
+/*!
+    Function that runs a single combination
+    @param result the result, its sink, threads, colors and pattern select the combination
+    @param records the number of records logged by every thread
+    @param samples the buffer of the latencies, records * threads long
+    @return 0 on success, -1 otherwise
+*/
+
+static int bench_run(BenchResult* result, size_t records, uint64_t* samples){
+
+    FILE *null_stream = NULL;
+
+    if(result->sink == SINK_NULL){
+        null_stream = fopen(BENCH_NULL_DEVICE, "w");
+        if(!null_stream){
+            fprintf(stderr, "[ERROR] Couldn't open file: %s\n", BENCH_NULL_DEVICE);
+            return -1;
+        }
+        zlog.set_output_stream(null_stream);
+    }else {
+        zlog.set_output_stream(stdout);
+    }
+
+    if(result->sink == SINK_FILE) remove(BENCH_FILE);
+
+    if(result->use_colors) zlog.set_flags(ZLOG_USE_COLORS);
+    else zlog.unset_flags(ZLOG_USE_COLORS);
+
+    if(zlog.set_pattern(result->pattern) != 0) return -1;
+
+    LogThread threads[BENCH_MAX_THREADS];
+    BenchWorker workers[BENCH_MAX_THREADS];
+
+    atomic_store(&bench_ready, 0);
+    atomic_store(&bench_go, 0);
+
+    int started = 0;
+
+    for(; started < result->threads; started++){
+        workers[started].sink = result->sink;
+        workers[started].records = records;
+        workers[started].samples = samples + (size_t)started * records;
+        if(zlog_thread_create(&threads[started], bench_worker, &workers[started]) != 0) break;
+    }
+
+    while(atomic_load(&bench_ready) < started) zlog_thread_yield();
+
+    uint64_t start = bench_now_ns();
+    atomic_store(&bench_go, 1);
+
+    for(int i = 0; i < started; i++){
+        zlog_thread_join(threads[i]);
+    }
+
+    zlog.flush();
+    uint64_t elapsed = bench_now_ns() - start;
+
+    zlog.close_files();
+    if(result->sink == SINK_FILE) remove(BENCH_FILE);
+
+    zlog.set_output_stream(stdout);
+    if(null_stream) fclose(null_stream);
+
+    if(started != result->threads){
+        fprintf(stderr, "[ERROR] Couldn't start the threads\n");
+        return -1;
+    }
+
+    size_t count = records * (size_t)result->threads;
+    uint64_t total = 0;
+
+    for(size_t i = 0; i < count; i++){
+        total += samples[i];
+    }
+
+    qsort(samples, count, sizeof(uint64_t), compare_samples);
+
+    result->ns_per_call = (double)total / (double)count;
+    result->records_per_second = (double)count * 1e9 / (double)(elapsed ? elapsed : 1);
+    result->p50 = percentile(samples, count, 0.50);
+    result->p99 = percentile(samples, count, 0.99);
+    result->p999 = percentile(samples, count, 0.999);
+    result->max = samples[count - 1];
+
+    return 0;
+
+}
+
+static void write_json_string(FILE* stream, const char* str){
+
+    fputc('"', stream);
+
+    for(; *str; str++){
+        if(*str == '"' || *str == '\\') fputc('\\', stream);
+        fputc(*str, stream);
+    }
+
+    fputc('"', stream);
+
+}
+
+static void write_json(FILE* stream, const BenchResult* results, size_t count, size_t records, int async){
+
+    fprintf(stream, "{\n  \"records_per_thread\": %zu,\n  \"async\": %s,\n  \"results\": [\n", records, async ? "true" : "false");
+
+    for(size_t i = 0; i < count; i++){
+
+        const BenchResult *result = &results[i];
+
+        fprintf(stream, "    { \"sink\": \"%s\", \"threads\": %d, \"colors\": %s, \"pattern\": ",
+                sink_names[result->sink], result->threads, result->use_colors ? "true" : "false");
+        write_json_string(stream, result->pattern);
+        fprintf(stream, ", \"ns_per_call\": %.1f, \"records_per_second\": %.0f, \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu }%s\n",
+                result->ns_per_call, result->records_per_second,
+                (unsigned long long)result->p50, (unsigned long long)result->p99,
+                (unsigned long long)result->p999, (unsigned long long)result->max,
+                i + 1 < count ? "," : "");
+
+    }
+
+    fprintf(stream, "  ]\n}\n");
+
+}
+
+static int parse_sinks(const char* list, int* sinks){
+
+    for(int i = 0; i < SINK_COUNT; i++){
+        sinks[i] = 0;
+    }
+
+    while(*list){
+
+        size_t length = strcspn(list, ",");
+        int found = 0;
+
+        for(int i = 0; i < SINK_COUNT; i++){
+            if(strlen(sink_names[i]) == length && strncmp(list, sink_names[i], length) == 0){
+                sinks[i] = 1;
+                found = 1;
+            }
+        }
+
+        if(!found){
+            fprintf(stderr, "[ERROR] Unknown sink: %.*s\n", (int)length, list);
+            return -1;
+        }
+
+        list += length;
+        if(*list == ',') list++;
+
+    }
+
+    return 0;
+
+}
+
+int main(int argc, char** argv){
+
+    int max_threads = 4;
+    size_t records = 100000;
+    int sinks[SINK_COUNT] = { 1, 1, 0 };
+    int async = 0;
+    const char *json = NULL;
+
+    for(int i = 1; i < argc; i++){
+
+        if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc){
+            max_threads = atoi(argv[++i]);
+        }else if(strcmp(argv[i], "--records") == 0 && i + 1 < argc){
+            records = (size_t)strtoull(argv[++i], NULL, 10);
+        }else if(strcmp(argv[i], "--sinks") == 0 && i + 1 < argc){
+            if(parse_sinks(argv[++i], sinks) != 0) return 1;
+        }else if(strcmp(argv[i], "--async") == 0){
+            async = 1;
+        }else if(strcmp(argv[i], "--json") == 0 && i + 1 < argc){
+            json = argv[++i];
+        }else {
+            fprintf(stderr, "Usage: %s [--threads <n>] [--records <n>] [--sinks <null,file,console>] [--async] [--json <file>]\n", argv[0]);
+            return 1;
+        }
+
+    }
+
+    if(max_threads < 1 || max_threads > BENCH_MAX_THREADS || records == 0){
+        fprintf(stderr, "[ERROR] The threads must be between 1 and %d and the records more than 0\n", BENCH_MAX_THREADS);
+        return 1;
+    }
+
+    uint64_t *samples = (uint64_t*)malloc(records * (size_t)max_threads * sizeof(uint64_t));
+    size_t capacity = SINK_COUNT * BENCH_MAX_THREADS * 2 * BENCH_PATTERN_COUNT;
+    BenchResult *results = (BenchResult*)malloc(capacity * sizeof(BenchResult));
+
+    if(!samples || !results){
+        fprintf(stderr, "[ERROR] Couldn't allocate the samples\n");
+        free(samples);
+        free(results);
+        return 1;
+    }
+
+    zlog_init("bench");
+
+    if(async){
+        zlog_async_init(BENCH_ASYNC_CAPACITY);
+        zlog_async_start();
+    }
+
+    fprintf(stderr, "%-8s %7s %6s %12s %14s %9s %9s %9s %10s  %s\n",
+            "sink", "threads", "colors", "ns/call", "records/s", "p50", "p99", "p99.9", "max", "pattern");
+
+    size_t count = 0;
+    int result = 0;
+
+    for(int sink = 0; sink < SINK_COUNT; sink++){
+
+        if(!sinks[sink]) continue;
+
+        for(int threads = 1; ; threads *= 2){
+
+            if(threads > max_threads) threads = max_threads;
+
+            for(int use_colors = 0; use_colors <= (sink == SINK_FILE ? 0 : 1); use_colors++){
+
+                for(size_t p = 0; p < BENCH_PATTERN_COUNT; p++){
+
+                    BenchResult *run = &results[count];
+                    memset(run, 0, sizeof(BenchResult));
+
+                    run->sink = (BenchSink)sink;
+                    run->threads = threads;
+                    run->use_colors = use_colors;
+                    run->pattern = bench_patterns[p];
+
+                    if(bench_run(run, records, samples) != 0){
+                        result = 1;
+                        continue;
+                    }
+
+                    fprintf(stderr, "%-8s %7d %6s %12.1f %14.0f %9llu %9llu %9llu %10llu  \"%s\"\n",
+                            sink_names[run->sink], run->threads, run->use_colors ? "on" : "off",
+                            run->ns_per_call, run->records_per_second,
+                            (unsigned long long)run->p50, (unsigned long long)run->p99,
+                            (unsigned long long)run->p999, (unsigned long long)run->max, run->pattern);
+
+                    count++;
+
+                }
+
+            }
+
+            if(threads == max_threads) break;
+
+        }
+
+    }
+
+    if(async) zlog_async_stop();
+
+    if(json){
+
+        FILE *stream = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+
+        if(stream){
+            write_json(stream, results, count, records, async);
+            if(stream != stdout) fclose(stream);
+        }else {
+            fprintf(stderr, "[ERROR] Couldn't open file: %s\n", json);
+            result = 1;
+        }
+
+    }
+
+    free(samples);
+    free(results);
+
+    return result;
+
+}
@@ -1,8 +1,8 @@
-#include <stdio.h>
-
 #define ZLOG_IMPLEMENTATION
 #include "src/zLog.h"
 
+#include <stdio.h>
+
 int main(void){
 
    zlog_init("zlogger");
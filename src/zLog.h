@@ -22,7 +22,8 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 
 HOW TO USE THE LIBRARY:
-    - Define the library implementation and include the header file:
+    - Define the library implementation and include the header file in one translation unit, 
+      the others include the header without the define:
         "#define ZLOG_IMPLEMENTATION
         #include "zlog.h"
     - Init the logger with the zlog_init() function by giving a name to the logger
@@ -38,36 +39,91 @@ HOW TO USE THE LIBRARY:
         - {l} = the location where the log is being called (the file and the line number)
         - {n} = the name of the logger
         - {t} = the tag of the log level 
+      The pattern is compiled once when it is set: zlog.set_pattern() returns -1 and keeps the previous pattern
+      if the new one is malformed.
     - Use the various log macros for the different log levels and log outputs (console (zlog) or a specific file (zflog))
+      The files are opened by the first zflog call and kept open: flush them with zlog.flush() and close them
+      with zlog.close_files()
     - Set the flags if you want the log messages in the console output have colors with the zlog.set_flags() | zlog.unset_flags() functions
       with the ZLOG_USE_COLORS flag
       - Set the flags if you want the debug log messages to be print or not with the zlog.set_flags() | zlog.unset_flags() functions
       with the ZLOG_DEBUG flag
+      - Set the flags if you want the date and the time in UTC instead of the local time with the zlog.set_flags() | zlog.unset_flags() functions
+      with the ZLOG_USE_UTC flag
+    - Create other loggers with zlog_create() and log to them with the zlogger_* macros, 
+      every logger has its own pattern, levels, flags and sinks
 */
 
 #ifndef ZLOG_H_
 #define ZLOG_H_
 
+/*
+    On Linux the implementation uses gettid() and sched_getcpu(), declared by the C library only with _GNU_SOURCE.
+    The define applies when the header is included before any system header, otherwise the fallbacks of 
+    zlog_current_thread_id() and zlog_current_cpu() are used
+*/
+
+#if defined ZLOG_IMPLEMENTATION && defined __linux__ && !defined _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+/*
+    Value of every level of logging, from the least to the most severe.
+    They are macros so that they can be compared by the preprocessor with ZLOG_ACTIVE_LEVEL
+*/
+
+#define ZLOG_LEVEL_TRACE    0
+#define ZLOG_LEVEL_DEBUG    1
+#define ZLOG_LEVEL_INFO     2
+#define ZLOG_LEVEL_WARNING  3
+#define ZLOG_LEVEL_ERROR    4
+#define ZLOG_LEVEL_FATAL    5
 
 /*
     Level of logging.
 */
 
 typedef enum {
-    L_INFO = 0,
-    L_DEBUG,
-    L_TRACE,
-    L_WARNING,
-    L_ERROR,
-    L_FATAL
+    L_TRACE = ZLOG_LEVEL_TRACE,
+    L_DEBUG = ZLOG_LEVEL_DEBUG,
+    L_INFO = ZLOG_LEVEL_INFO,
+    L_WARNING = ZLOG_LEVEL_WARNING,
+    L_ERROR = ZLOG_LEVEL_ERROR,
+    L_FATAL = ZLOG_LEVEL_FATAL
 }LogLevel;
 
+/*
+    Compile time threshold: the log macros of the levels below it expand to nothing, 
+    their arguments are still type checked but never evaluated.
+    Define it before including the header, e.g. -DZLOG_ACTIVE_LEVEL=ZLOG_LEVEL_INFO
+*/
+
+#ifndef ZLOG_ACTIVE_LEVEL
+#define ZLOG_ACTIVE_LEVEL ZLOG_LEVEL_TRACE
+#endif
+
+/*
+    Attributes that let the compiler check the format string against the args 
+    and keep quiet about the look up tables unused by the translation units without the implementation
+*/
+
+#if defined (__GNUC__) || defined (__clang__)
+#define ZLOG_PRINTF_FORMAT(fmt_index, args_index) __attribute__((format(printf, fmt_index, args_index)))
+#define ZLOG_MAYBE_UNUSED __attribute__((unused))
+#else
+#define ZLOG_PRINTF_FORMAT(fmt_index, args_index)
+#define ZLOG_MAYBE_UNUSED
+#endif
+
 /*
     Look up table for the tag of every level of logging 
 */
 
-static const char * log_tag[] = {
+static const char * log_tag[] ZLOG_MAYBE_UNUSED = {
     [L_INFO] = "INFO",
     [L_DEBUG] = "DEBUG",
     [L_TRACE] = "TRACE",
@@ -77,51 +133,31 @@ static const char * log_tag[] = {
 };
 
 /*
-    Look up table for the color of every level of logging
+    List of ansi colors used by the logger.
+    On Windows the virtual terminal processing of the console is enabled by zlog_init(), 
+    so that the colors can be written in the record together with the text.
 */
-#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
 
-    /*
-    List of ansi colors used by the logger.
-    */
-
-    #define ANSI_COLOR_RED     "\x1b[0;31m"
-    #define ANSI_COLOR_GREEN   "\x1b[0;32m"
-    #define ANSI_COLOR_YELLOW  "\x1b[0;33m"
-    #define ANSI_COLOR_BLUE    "\x1b[0;34m"
-    #define ANSI_COLOR_MAGENTA "\x1b[0;35m"
-    #define ANSI_COLOR_CYAN    "\x1b[0;36m"
-    #define ANSI_COLOR_RESET   "\x1b[0m"
-
-    static const char * log_color[] = {
-        [L_INFO] = ANSI_COLOR_GREEN,
-        [L_DEBUG] = ANSI_COLOR_YELLOW,
-        [L_TRACE] = ANSI_COLOR_CYAN,
-        [L_WARNING] = ANSI_COLOR_YELLOW,
-        [L_ERROR] = ANSI_COLOR_RED,
-        [L_FATAL] = ANSI_COLOR_RED
-    };
-#elif _WIN32  
-    #include <Windows.h>
-
-    #define C_Blue             1          
-    #define C_Green            2         
-    #define C_Cyan             3           
-    #define C_Red              4          
-    #define C_Magenta          5                  
-    #define C_White            7          
-    #define C_Yellow           14
-
-    int log_color[] = {
-        [L_INFO] = C_Green,
-        [L_DEBUG] = C_Yellow,
-        [L_TRACE] = C_Cyan,
-        [L_WARNING] = C_Yellow,
-        [L_ERROR] = C_Red,
-        [L_FATAL] = C_Red
-    };
-#endif
+#define ANSI_COLOR_RED     "\x1b[0;31m"
+#define ANSI_COLOR_GREEN   "\x1b[0;32m"
+#define ANSI_COLOR_YELLOW  "\x1b[0;33m"
+#define ANSI_COLOR_BLUE    "\x1b[0;34m"
+#define ANSI_COLOR_MAGENTA "\x1b[0;35m"
+#define ANSI_COLOR_CYAN    "\x1b[0;36m"
+#define ANSI_COLOR_RESET   "\x1b[0m"
+
+/*
+    Look up table for the color of every level of logging
+*/
 
+static const char * log_color[] ZLOG_MAYBE_UNUSED = {
+    [L_INFO] = ANSI_COLOR_GREEN,
+    [L_DEBUG] = ANSI_COLOR_YELLOW,
+    [L_TRACE] = ANSI_COLOR_CYAN,
+    [L_WARNING] = ANSI_COLOR_YELLOW,
+    [L_ERROR] = ANSI_COLOR_RED,
+    [L_FATAL] = ANSI_COLOR_RED
+};
 
 /*
     Bit position of every flag
@@ -130,7 +166,7 @@ static const char * log_tag[] = {
 typedef enum BIT_flags{
     ZLOG_BIT_DEBUG = 0,
     ZLOG_BIT_USE_COLORS = 1,
-    ZLOG_BIT_CHECK_COLOR = 4
+    ZLOG_BIT_USE_UTC = 2
 }LogBitFlags;
 
 /*!  
@@ -144,15 +180,20 @@ typedef enum BIT_flags{
     ZLOG_LOCATION = SHOW THE FILE LOCATION AND THE LINE WHERE THE MESSAGE HAS BEEN LOGGED
     ZLOG_FUNCTION = SHOW THE FUNCTION WHERE THE MESSAGE HAS BEEN LOGGED
     ZLOG_DEBUG = SHOW THE MESSAGE LOGGED WITH A LOG LEVEL SET TO DEBUG MODE
-    ZLOG_USE_COLORS = LOG THE MESSAGE AND THE OTHER INFORMATIONS WITH COLORS, ONLY ON THE CONSOLE AND NOT THE FILE MODE
+    ZLOG_USE_COLORS = LOG THE MESSAGE AND THE OTHER INFORMATIONS WITH COLORS, ONLY ON THE SINKS THAT USE COLORS
+    ZLOG_USE_UTC = RENDER THE DATE AND THE TIME IN UTC INSTEAD OF THE LOCAL TIME, NOT PART OF ZLOG_ALL
 */
 typedef enum flags{
     ZLOG_DEBUG = 1 << ZLOG_BIT_DEBUG,
     ZLOG_USE_COLORS = 1 << ZLOG_BIT_USE_COLORS,
-    ZLOG_CHECK_COLOR = 1 << ZLOG_BIT_CHECK_COLOR,
+    ZLOG_USE_UTC = 1 << ZLOG_BIT_USE_UTC,
     ZLOG_ALL = ZLOG_USE_COLORS | ZLOG_DEBUG 
 }LogFlags;
 
+/*
+    Kind of every instruction of a compiled pattern
+*/
+
 typedef enum {
     
     DAY,
@@ -161,79 +202,418 @@ typedef enum {
     HOUR,
     MINUTE,
     SECOND,
+    MILLISECOND,
+    MICROSECOND,
+    NANOSECOND,
+    THREAD,
+    CPU,
     FUNCTION,
     LOCATION,
+    NAME,
     TAG,
+    LITERAL,
     PATTER_COUNT
 
 }PatternType;
 
+/*
+    Macros that check whether an instruction of a compiled pattern is a date or time field 
+    and whether it is rendered for every record (date, time, thread and cpu) instead of once per callsite
+*/
+
+#define ZLOG_IS_TIME_FIELD(type) ((type) <= NANOSECOND)
+#define ZLOG_IS_RECORD_FIELD(type) ((type) <= CPU)
+
+/*
+    Max number of instructions of a compiled pattern
+*/
+
+#define ZLOG_PATTERN_MAX_OPS 64
+
+/*!
+    Single instruction of a compiled pattern
+
+    @param type the field printed by the instruction
+    @param offset the offset of the text inside the pattern source (LITERAL only)
+    @param length the length of the text inside the pattern source (LITERAL only)
+*/
+typedef struct {
+
+    PatternType type;
+    uint16_t offset;
+    uint16_t length;
+
+}PatternOp;
+
+/*!
+    Pattern compiled once by zlog.set_pattern() and executed by every log call
+
+    @param source a copy of the pattern string, literal spans point inside of it
+    @param id the unique id of the compiled pattern, the callsites cache their prefix for an id
+    @param precise whether the pattern has sub-second fields, its records read the precise clock
+    @param count the number of instructions
+    @param ops the instructions: literal spans and fields in order of appearance
+*/
+typedef struct CompiledPattern {
+
+    char * source;
+    uint64_t id;
+    int precise;
+    size_t count;
+    PatternOp ops[ZLOG_PATTERN_MAX_OPS];
+
+}CompiledPattern;
+
+
+
+/*
+    Number of prefixes a callsite keeps for every level, for the helpers that log to several loggers
+*/
+
+#ifndef ZLOG_SITE_PREFIXES
+#define ZLOG_SITE_PREFIXES 2
+#endif
+
+/*!
+    Mutable part of a callsite, filled by the first log call of the callsite
+
+    @param prefix the prefixes of the callsite for every level, without and with colors, keyed on the pattern and the logger. 
+                  A slot is filled by the first record of its pattern and emptied when the pattern is replaced, 
+                  the records that find every slot taken render the whole pattern
+    @param binary the id of the callsite in the binary file, with the binary session in the high 32 bits
+    @param fmt a copy of the first format string written to a binary file, the id is reused only by the records with the same format
+    @param registered whether the callsite is in the list of the callsites with prefixes
+    @param next the next callsite of that list
+*/
+typedef struct LogSiteCache {
+
+    _Atomic(struct LogSitePrefix *) prefix[2][L_FATAL + 1][ZLOG_SITE_PREFIXES];
+    _Atomic(uint64_t) binary;
+    _Atomic(char *) fmt;
+    atomic_int registered;
+    struct LogSiteCache * next;
+
+}LogSiteCache;
+
+/*!
+    Static descriptor defined by every log macro where it is expanded
+
+    @param filename the file of the callsite
+    @param fun_name the function of the callsite
+    @param line the line of the callsite
+    @param level the level of the log macro (the zlog() and zflog() macros pass the current level on every call)
+    @param cache the data computed once for the callsite
+*/
+typedef struct {
+
+    const char * filename;
+    const char * fun_name;
+    uint32_t line;
+    LogLevel level;
+    LogSiteCache * cache;
+
+}LogCallsite;
+
+/*
+    Max number of sinks of the logger
+*/
+
+#define ZLOG_MAX_SINKS 8
+
+/*
+    Interval of the time based rotation of a file sink
+*/
+
+typedef enum {
+    ZLOG_ROTATE_NEVER,
+    ZLOG_ROTATE_HOURLY,
+    ZLOG_ROTATE_DAILY
+}LogRotateInterval;
+
+/*!
+    Codec used to compress the rotated files
+
+    @param extension the extension added to the compressed files
+    @param compress function that compresses the source file into the target file, returns 0 on success or -1 otherwise
+*/
+typedef struct {
+
+    const char * extension;
+    int (*compress)(FILE* source, FILE* target);
+
+}LogCodec;
+
+/*
+    Built-in fast codec (LZ4 like blocks), the files compressed with it are read by zlog-decode
+*/
+
+extern const LogCodec zlog_codec_lz;
+
+/*!
+    Rotation of a file sink: the file is renamed to file.1 (file.1 to file.2 and so on) and opened again
+
+    @param max_bytes the max size of the file, 0 for no limit
+    @param interval the file is also rotated at the start of every hour or day
+    @param max_files the number of rotated files that are kept, 0 to truncate the file instead
+    @param codec the codec that compresses the rotated files on a low priority background thread, NULL to keep them as they are
+*/
+typedef struct {
+
+    uint64_t max_bytes;
+    LogRotateInterval interval;
+    unsigned max_files;
+    const LogCodec * codec;
+
+}LogRotation;
+
+/*!
+    Output of the logger
+
+    @param stream the stream where the records are written, NULL for the file sinks
+    @param min_level the minimum level of the records written to the sink
+    @param use_colors whether the records are written with colors, only if the ZLOG_USE_COLORS flag is set too
+    @param owned whether the stream has been opened by the logger, it is closed when the sink is removed
+    @param file the file of the sinks added by add_file_sink() and add_rotating_file_sink()
+*/
+typedef struct {
+
+    FILE * stream;
+    LogLevel min_level;
+    int use_colors;
+    int owned;
+    struct LogFile * file;
+
+}LogSink;
+
+/*!
+    List of the sinks of the logger, every change publishes a new list
+
+    @param count the number of sinks
+    @param sinks the sinks, the first one is the output stream set by open_file() and set_output_stream()
+*/
+typedef struct LogSinkList {
+
+    size_t count;
+    LogSink sinks[ZLOG_MAX_SINKS];
+
+}LogSinkList;
+
+/*!
+    What a log call does when the ring of its thread is full in asynchronous mode
+
+    - ZLOG_OVERFLOW_BLOCK waits until the background thread frees a slot (the default)
+    - ZLOG_OVERFLOW_DROP drops the new record
+    - ZLOG_OVERFLOW_OVERWRITE drops the oldest record of the ring to make room for the new one
+    - ZLOG_OVERFLOW_SPILL moves the record to a secondary buffer written by the background thread, 
+      the record is dropped only if that buffer is full too
+*/
+
+typedef enum {
+    ZLOG_OVERFLOW_BLOCK,
+    ZLOG_OVERFLOW_DROP,
+    ZLOG_OVERFLOW_OVERWRITE,
+    ZLOG_OVERFLOW_SPILL
+}LogOverflowPolicy;
+
+/*!
+    Clock that timestamps the records of a logger, read as raw ticks and converted to wall time when the record is formatted
+    (or by zlog-decode for the binary files). The patterns without sub-second fields read the coarse wall clock in text mode
+
+    - ZLOG_CLOCK_REALTIME reads the wall clock
+    - ZLOG_CLOCK_COARSE reads the coarse wall clock, with the resolution of the scheduler tick
+    - ZLOG_CLOCK_MONOTONIC reads the monotonic clock, calibrated against the wall clock every ZLOG_CLOCK_CALIBRATION_NS (the default)
+    - ZLOG_CLOCK_TSC reads the time stamp counter of the cpu, calibrated against the wall clock when it is set 
+      and every ZLOG_CLOCK_CALIBRATION_NS. Available on x86 and arm64, it needs an invariant tsc
+*/
 
+typedef enum {
+    ZLOG_CLOCK_REALTIME,
+    ZLOG_CLOCK_COARSE,
+    ZLOG_CLOCK_MONOTONIC,
+    ZLOG_CLOCK_TSC
+}LogClockSource;
 
 /*!
-    Struct that contains every bit of information about the log system and its functions
+    Counters of the records a logger pushes to the rings of the asynchronous mode
+
+    @param dropped the records dropped because the ring was full
+    @param spilled the records moved to the spill buffer
+    @param blocked_ns the nanoseconds the log calls waited for a free slot
+    @param high_water the highest number of records a log call has found in the ring of its thread
+*/
+typedef struct {
+
+    uint64_t dropped;
+    uint64_t spilled;
+    uint64_t blocked_ns;
+    uint64_t high_water;
 
-    @param level the current log level of the logger
+}LogAsyncStats;
+
+/*!
+    Struct that contains every bit of information about a logger and the functions of the default logger.
+    The fields shared by the threads are atomics: the log calls only read them and get the level 
+    and the output stream per call, so they never write the logger.
+    The function pointers are set only on the default logger zlog, the loggers returned by zlog_create()
+    are changed with the zlogger_*() functions.
+
+    @param level the log level used by the zlog() macro
+    @param min_level the minimum level of the messages written to the sinks
+    @param accept_level the lowest level accepted by the logger, checked by the log macros before evaluating the args:
+                        min_level, or L_TRACE while the backtrace keeps the records below min_level
     @param flags the bitfield that contains all the flags used by the logger
     @param mode the mode in which the logger will print the message in the file:
                 - "a" to append the message to the file.
                 - "w" to overwrite the file.
-    @param Stream the current stream in which the logger is printing the message
+    @param sinks the outputs of the logger, every record is formatted once and written to the sinks that accept its level
     @param pattern the pattern of the log message 
+    @param compiled the pattern compiled into literal spans and fields
+    @param backtrace the ring of the last records below the minimum level, NULL until the backtrace is enabled
+    @param clock the clock that timestamps the records
+    @param overflow what the log calls do when the ring of their thread is full in asynchronous mode
+    @param dropped the records dropped because the ring was full, counted on the logger that has pushed them
+    @param spilled the records moved to the spill buffer
+    @param blocked_ns the nanoseconds the log calls waited for a free slot
+    @param high_water the highest number of records a log call has found in the ring of its thread
+    @param reported the dropped records already reported by the summary line
+    @param report_time the time of the last summary line, in seconds
 
     @param set_level function that sets the log level of the logger
+    @param set_min_level function that sets the minimum level of the messages that are logged
 
     @param set_file_write_mode function that sets the mode of writing the message into the file
     @param open_file function the opens a file and set it as the new stream
     @param clear_file function the clears the file 
     @param close_stream function the closes the current stream of the logger
     @param set_output_stream function the sets the output stream of the logger
+    @param add_sink function that adds a stream to the sinks, returns 0 on success or -1 if there are too many sinks
+    @param add_file_sink function that opens a file with the write mode and adds it to the sinks without colors, 
+                         returns 0 on success or -1 otherwise
+    @param add_rotating_file_sink function that adds a file sink rotated by size and/or time, returns 0 on success or -1 otherwise
+    @param remove_sink function that removes a stream from the sinks, the files opened by the logger are closed
+    @param remove_file_sink function that removes the file sinks of a path and closes their files
+    @param set_sink_level function that sets the minimum level of the records written to a sink
+    @param set_sink_colors function that sets whether the records are written to a sink with colors
+    @param flush function that flushes the output stream and every open log file
+    @param close_files function that closes every log file opened by the zflog macros
+
+    @param enable_backtrace function that keeps the last records below the minimum level (and the debug records without
+                            the ZLOG_DEBUG flag) in a ring, written to the sinks when an error is logged.
+                            Returns 0 on success or -1 if the ring couldn't be allocated
+    @param disable_backtrace function that stops keeping the records and drops the ones in the ring
+    @param dump_backtrace function that writes the records of the ring to the sinks and empties it
+
+    @param set_clock function that sets the clock that timestamps the records, 
+                     returns 0 on success or -1 if the clock is not available on the machine
+    @param set_overflow_policy function that sets what the log calls do when the ring of their thread is full,
+                               returns 0 on success or -1 if the spill buffer couldn't be allocated
+    @param get_async_stats function that returns the counters of the records pushed to the rings
 
     @param get_flags functions that return the value of the flags
     @param set_flags function that set the specified flags of the logger
     @param unset_flags function that unset the specified flags of the logger
     @param flip_flags function that flips the value of the specified flags of the logger
     
-    @param set_pattern function that sets the pattern of the log message
+    @param set_pattern function that compiles and sets the pattern of the log message, 
+                       returns 0 on success or -1 if the pattern is malformed (the previous pattern is kept)
 */
 typedef struct {
 
     const char *name;
-    LogLevel level;
-    uint8_t flags;
-    const char * mode;
-    FILE* Stream;
-    char * pattern;
+    _Atomic(LogLevel) level;
+    _Atomic(LogLevel) min_level;
+    _Atomic(LogLevel) accept_level;
+    _Atomic(uint8_t) flags;
+    _Atomic(const char *) mode;
+    _Atomic(LogSinkList*) sinks;
+    _Atomic(const char *) pattern;
+    _Atomic(CompiledPattern *) compiled;
+    _Atomic(struct LogBacktrace *) backtrace;
+    _Atomic(LogClockSource) clock;
+    _Atomic(LogOverflowPolicy) overflow;
+    _Atomic(uint64_t) dropped;
+    _Atomic(uint64_t) spilled;
+    _Atomic(uint64_t) blocked_ns;
+    _Atomic(uint64_t) high_water;
+    _Atomic(uint64_t) reported;
+    _Atomic(int64_t) report_time;
     
     void (*set_level)(LogLevel level);
+    void (*set_min_level)(LogLevel level);
 
     void (*set_file_write_mode)(const char * mode);
     void (*open_file)(const char* filename);
     void (*clear_file)(const char* filename);
     void (*close_stream)();
     void (*set_output_stream)(FILE* Stream);
+    int (*add_sink)(FILE* stream, LogLevel min_level, int use_colors);
+    int (*add_file_sink)(const char* filename, LogLevel min_level);
+    int (*add_rotating_file_sink)(const char* filename, LogLevel min_level, const LogRotation* rotation);
+    void (*remove_sink)(FILE* stream);
+    void (*remove_file_sink)(const char* filename);
+    void (*set_sink_level)(FILE* stream, LogLevel min_level);
+    void (*set_sink_colors)(FILE* stream, int use_colors);
+    void (*flush)();
+    void (*close_files)();
+
+    int (*enable_backtrace)(size_t capacity);
+    void (*disable_backtrace)();
+    void (*dump_backtrace)();
+
+    int (*set_clock)(LogClockSource clock);
+    int (*set_overflow_policy)(LogOverflowPolicy policy);
+    LogAsyncStats (*get_async_stats)();
 
     uint8_t (*get_flags)();
     void (*set_flags)(LogFlags flags);
     void (*unset_flags)(LogFlags flags);
     void (*flip_flags)(LogFlags flags);
 
-    void (*set_pattern)(char* pattern);
+    int (*set_pattern)(const char* pattern);
 
 }zlogger;
 
+/*!
+    Configuration of a logger created by zlog_create(), a NULL configuration uses the defaults of zlog_init()
+
+    @param pattern the pattern of the log message, NULL for the default one
+    @param min_level the minimum level of the messages that are logged
+    @param flags the flags of the logger
+    @param mode the mode in which the files are opened, NULL for "a"
+    @param stream the output stream, NULL for stderr
+    @param use_colors whether the output stream is written with colors
+*/
+typedef struct {
+
+    const char * pattern;
+    LogLevel min_level;
+    uint8_t flags;
+    const char * mode;
+    FILE * stream;
+    int use_colors;
+
+}LogConfig;
+
 /*
-    The logger used globally
+    The default logger, used by the log macros without a logger handle
 */
 
-zlogger zlog;
+extern zlogger zlog;
+
+/*!
+    Macro used to check a specific bit mask between the flags of a logger
+    @param logger the logger
+    @param flag the flag to check 
+*/
+
+#define ZLOG_CHECK_FLAG(logger, flag) (atomic_load_explicit(&(logger)->flags, memory_order_relaxed) & (1 << flag))
 
 /*!
-    Macro used to check a specific bit mask between the flags 
+    Macro used to check a specific bit mask between the flags of the default logger
     @param flag the flag to check 
 */
 
-#define CHECK_FLAG(flag) (zlog.flags & (1 << flag))
+#define CHECK_FLAG(flag) ZLOG_CHECK_FLAG(&zlog, flag)
 
 /*!
     Function that initialize the logger
@@ -243,22 +623,143 @@ zlogger zlog;
 void zlog_init(const char* log_name);
 
 /*!
-    Base function to log a message to the console or a file
-    @param filename the file where the log is being called
-    @param line the line where the log is being called
-    @param fun_name the function where the log is being called
+    Function that creates a logger with its own pattern, level, flags and sinks.
+    The asynchronous mode, the binary mode and the files of the zflog macros are shared with the default logger
+    @param name the name of the logger
+    @param config the configuration of the logger, NULL for the defaults
+    @return the logger or NULL if it couldn't be created
+*/
+
+zlogger* zlog_create(const char* name, const LogConfig* config);
+
+/*!
+    Function that destroys a logger created by zlog_create(), closing the files it has opened.
+    Call it when no thread is logging to the logger anymore
+    @param logger the logger
+*/
+
+void zlog_destroy(zlogger* logger);
+
+/*
+    Functions that change a logger, the same as the function pointers of the default logger
+*/
+
+void zlogger_set_level(zlogger* logger, LogLevel level);
+void zlogger_set_min_level(zlogger* logger, LogLevel level);
+void zlogger_set_flags(zlogger* logger, LogFlags flags);
+void zlogger_unset_flags(zlogger* logger, LogFlags flags);
+int zlogger_set_pattern(zlogger* logger, const char* pattern);
+void zlogger_set_output_stream(zlogger* logger, FILE* stream);
+int zlogger_add_sink(zlogger* logger, FILE* stream, LogLevel min_level, int use_colors);
+int zlogger_add_file_sink(zlogger* logger, const char* filename, LogLevel min_level);
+int zlogger_add_rotating_file_sink(zlogger* logger, const char* filename, LogLevel min_level, const LogRotation* rotation);
+void zlogger_remove_sink(zlogger* logger, FILE* stream);
+void zlogger_remove_file_sink(zlogger* logger, const char* filename);
+void zlogger_set_sink_level(zlogger* logger, FILE* stream, LogLevel min_level);
+void zlogger_set_sink_colors(zlogger* logger, FILE* stream, int use_colors);
+void zlogger_flush(zlogger* logger);
+int zlogger_enable_backtrace(zlogger* logger, size_t capacity);
+void zlogger_disable_backtrace(zlogger* logger);
+void zlogger_dump_backtrace(zlogger* logger);
+int zlogger_set_clock(zlogger* logger, LogClockSource clock);
+int zlogger_set_overflow_policy(zlogger* logger, LogOverflowPolicy policy);
+LogAsyncStats zlogger_get_async_stats(zlogger* logger);
+
+/*!
+    Function that sets the capacity of the rings of the asynchronous mode.
+    In asynchronous mode the log calls render the record and push it into a lock free ring of their thread, 
+    allocated by the first record of the thread and freed once the thread has exited.
+    A background thread drains the rings and writes the records to their streams, merged in timestamp order
+    @param capacity the number of records the ring of a thread can hold, rounded up to a power of two
+    @return 0 on success, -1 if the asynchronous mode is running
+*/
+
+int zlog_async_init(size_t capacity);
+
+/*!
+    Function that starts the background thread and switches the logger to the asynchronous mode.
+    zlog_async_stop() is registered with atexit() so that the rings are always drained at shutdown
+    @return 0 on success, -1 if zlog_async_init() has not been called or the thread couldn't be started
+*/
+
+int zlog_async_start();
+
+/*!
+    Function that switches the logger back to the synchronous mode, 
+    the records still in the rings are written before it returns
+*/
+
+void zlog_async_stop();
+
+/*!
+    Function that waits until every record pushed before the call has been written, then flushes the streams
+*/
+
+void zlog_async_flush();
+
+/*!
+    Function that switches the logger to the binary mode: the log calls to the output stream write
+    the callsite, the timestamp and the raw args of the message to the binary file, without formatting them.
+    The file is turned back into text by the zlog-decode tool, with the pattern set when the file has been opened.
+    Call it before the other threads start logging
+    @param path the path of the binary file, opened with the write mode of the logger
+    @return 0 on success, -1 if the file couldn't be opened
+*/
+
+int zlog_binary_open(const char* path);
+
+/*!
+    Function that closes the binary file and switches the logger back to the text mode
+*/
+
+void zlog_binary_close();
+
+/*!
+    Function that returns the number of allocations made by the library, used by the tests to check 
+    that the log calls don't allocate once every thread and callsite has logged its first record
+    @return the number of allocations
+*/
+
+size_t zlog_allocation_count();
+
+/*!
+    Base function to log a message to the sinks of a logger
+    @param logger the logger
+    @param site the callsite of the log
+    @param level the level of the log
+    @param fmt the string to format and print 
+    @param ... the various args used to format the string 
+*/
+
+void zlog_(zlogger* logger, const LogCallsite* site, LogLevel level, const char* fmt, ...) ZLOG_PRINTF_FORMAT(4, 5);
+
+/*!
+    Base function to log a message to a file. 
+    The file is opened by the first call and kept open for the next ones, until zlog.close_files() is called 
+    @param output_file the file where the log message is being printed
+    @param site the callsite of the log
+    @param level the level of the log
     @param fmt the string to format and print 
     @param ... the various args used to format the string 
 */
 
-void zlog_(const char* filename, size_t line, const char* fun_name, const char* fmt, ...);
+void zflog_(const char* output_file, const LogCallsite* site, LogLevel level, const char* fmt, ...) ZLOG_PRINTF_FORMAT(4, 5);
+
+/*!
+    Function never called, used by the disabled log macros to type check their args
+    @param fmt the string to format
+    @param ... the args used to format the string
+*/
+
+static inline void zlog_check_format_(const char* fmt, ...) ZLOG_PRINTF_FORMAT(1, 2);
+static inline void zlog_check_format_(const char* fmt, ...){ (void)fmt; }
 
 /*!
     Macro that will log a message to the console at the current log level defined 
     @param ... the message to log 
 */
 
-#define zlog(...)                       zlog_(__FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)   
+#define zlog(...)                       _zlog_at(L_INFO, atomic_load_explicit(&zlog.level, memory_order_relaxed), __VA_ARGS__)   
 
 /*!
     Macro that will log a message to a file at the current log level defined 
@@ -266,68 +767,108 @@ void zlog_(const char* filename, size_t line, const char* fun_name, const char*
     @param ... the message to log 
 */
 
-#define zflog(output_file, ...)         zlog.open_file(output_file); \
-                                        zlog_(__FILE__, __LINE__, __FUNCTION__, __VA_ARGS__);\
-                                        zlog.close_stream();
+#define zflog(output_file, ...)         _zflog_at(output_file, L_INFO, atomic_load_explicit(&zlog.level, memory_order_relaxed), __VA_ARGS__)
+
+/*!
+    Macro that checks the level of a message against the lowest level accepted by a logger 
+    with a single relaxed load, before anything else is done for the message
+    @param logger the logger
+    @param level the level of the message
+*/
+
+#define ZLOG_ENABLED_IN(logger, level) ((int)(level) >= (int)atomic_load_explicit(&(logger)->accept_level, memory_order_relaxed))
+#define ZLOG_ENABLED(level) ZLOG_ENABLED_IN(&zlog, level)
+
+/*!
+    Macro that defines the static descriptor of the callsite where it is expanded, 
+    the format string is passed on every call so it can be built at runtime
+    @param level the level of the log macro
+*/
+
+#define ZLOG_CALLSITE(level)    static LogSiteCache zlog_site_cache_; \
+                                static const LogCallsite zlog_site_ = { __FILE__, __FUNCTION__, __LINE__, level, &zlog_site_cache_ }
 
 /*!
-    Macro that will log a message to the console with a specified level
+    Macros that will log a message to the sinks of a logger with a level that can differ from the one of the callsite
+    @param logger the logger
+    @param site_level the level of the callsite
     @param level the level of the log 
     @param ... The message to be logged
 */
 
-#define _zlog(level, ...)   zlog.set_level(level);\
-                            zlog.set_output_stream(stderr);\
-                            zlog(__VA_ARGS__)
+#define _zlog_in(logger, site_level, level, ...)        do { zlogger *zlog_logger_ = (logger); if(ZLOG_ENABLED_IN(zlog_logger_, level)){ \
+                                                            ZLOG_CALLSITE(site_level); \
+                                                            zlog_(zlog_logger_, &zlog_site_, level, __VA_ARGS__); } } while(0)
+#define _zlog_at(site_level, level, ...)                _zlog_in(&zlog, site_level, level, __VA_ARGS__)
+#define _zflog_at(output_file, site_level, level, ...)  do { if(ZLOG_ENABLED(level)){ ZLOG_CALLSITE(site_level); \
+                                                            zflog_(output_file, &zlog_site_, level, __VA_ARGS__); } } while(0)
 
 /*!
-    Macro that will log a message to a file with a specified level
-    @param output_file the name of the output file 
+    Macro that will log a message to the output stream of the logger with a specified level
     @param level the level of the log 
     @param ... The message to be logged
-*/                            
+*/
 
-#define _zflog(output_file, level, ...)     zlog.set_level(level); \
-                                            zflog(output_file, ##__VA_ARGS__) \
+#define _zlog(level, ...)   _zlog_at(level, level, __VA_ARGS__)
 
 /*!
-    Logs to the console the info message
+    Macro that will log a message to the sinks of a logger with a specified level
+    @param logger the logger
+    @param level the level of the log 
     @param ... The message to be logged
-*/               
-#define zlog_info(...)      _zlog(L_INFO,    ##__VA_ARGS__)
+*/
+
+#define _zlogger(logger, level, ...)    _zlog_in(logger, level, level, __VA_ARGS__)
+
 /*!
-    Logs to the console the debug message
+    Macro that will log a message to a file with a specified level
+    @param output_file the name of the output file 
+    @param level the level of the log 
     @param ... The message to be logged
-*/  
-#define zlog_debug(...)     _zlog(L_DEBUG,   ##__VA_ARGS__)
+*/                            
+
+#define _zflog(output_file, level, ...)     _zflog_at(output_file, level, level, __VA_ARGS__)
+
 /*!
-    Logs to the console the trace message
-    @param ... The message to be logged
-    @hideinitializer
-*/  
-#define zlog_trace(...)     _zlog(L_TRACE,   ##__VA_ARGS__)
+    Macros that replace the log macros of the levels below ZLOG_ACTIVE_LEVEL
+    @param output_file the name of the output file 
+    @param ... The message that won't be logged
+*/
+
+#define _zlog_disabled(...)                 do { if(0){ zlog_check_format_(__VA_ARGS__); } } while(0)
+#define _zflog_disabled(output_file, ...)   do { if(0){ (void)(output_file); zlog_check_format_(__VA_ARGS__); } } while(0)
+#define _zlogger_disabled(logger, ...)      do { if(0){ (void)(logger); zlog_check_format_(__VA_ARGS__); } } while(0)
+
+#if ZLOG_ACTIVE_LEVEL <= ZLOG_LEVEL_TRACE
 /*!
-    Logs to the console the warning message
+    Logs to the console the trace message
     @param ... The message to be logged
 */  
-#define zlog_warning(...)   _zlog(L_WARNING, ##__VA_ARGS__)
+#define zlog_trace(...)                 _zlog(L_TRACE,   ##__VA_ARGS__)
 /*!
-    Logs to the console the error message
+    Logs into the output_file the trace message
+    @param output_file the name of the output file 
     @param ... The message to be logged
-*/  
-#define zlog_error(...)     _zlog(L_ERROR,   ##__VA_ARGS__)
+*/
+#define zflog_trace(output_file, ...)   _zflog(output_file,  L_TRACE,     ##__VA_ARGS__)
 /*!
-    Logs to the console the fatal message
+    Logs to the sinks of a logger the trace message
+    @param logger the logger
     @param ... The message to be logged
-*/  
-#define zlog_fatal(...)     _zlog(L_FATAL,   ##__VA_ARGS__)
+*/
+#define zlogger_trace(logger, ...)      _zlogger(logger, L_TRACE, ##__VA_ARGS__)
+#else
+#define zlog_trace(...)                 _zlog_disabled(__VA_ARGS__)
+#define zflog_trace(output_file, ...)   _zflog_disabled(output_file, __VA_ARGS__)
+#define zlogger_trace(logger, ...)      _zlogger_disabled(logger, __VA_ARGS__)
+#endif
 
+#if ZLOG_ACTIVE_LEVEL <= ZLOG_LEVEL_DEBUG
 /*!
-    Logs into the output_file the info message
-    @param output_file the name of the output file 
+    Logs to the console the debug message
     @param ... The message to be logged
-*/
-#define zflog_info(output_file, ...)    _zflog(output_file,  L_INFO,      ##__VA_ARGS__)
+*/  
+#define zlog_debug(...)                 _zlog(L_DEBUG,   ##__VA_ARGS__)
 /*!
     Logs into the output_file the debug message
     @param output_file the name of the output file 
@@ -335,29 +876,112 @@ void zlog_(const char* filename, size_t line, const char* fun_name, const char*
 */
 #define zflog_debug(output_file, ...)   _zflog(output_file,  L_DEBUG,     ##__VA_ARGS__)
 /*!
-    Logs into the output_file the trace message
-    @param output_file the name of the output file 
+    Logs to the sinks of a logger the debug message
+    @param logger the logger
     @param ... The message to be logged
 */
-#define zflog_trace(output_file, ...)   _zflog(output_file,  L_TRACE,     ##__VA_ARGS__)
-/*!
+#define zlogger_debug(logger, ...)      _zlogger(logger, L_DEBUG, ##__VA_ARGS__)
+#else
+#define zlog_debug(...)                 _zlog_disabled(__VA_ARGS__)
+#define zflog_debug(output_file, ...)   _zflog_disabled(output_file, __VA_ARGS__)
+#define zlogger_debug(logger, ...)      _zlogger_disabled(logger, __VA_ARGS__)
+#endif
+
+#if ZLOG_ACTIVE_LEVEL <= ZLOG_LEVEL_INFO
+/*!
+    Logs to the console the info message
+    @param ... The message to be logged
+*/               
+#define zlog_info(...)                  _zlog(L_INFO,    ##__VA_ARGS__)
+/*!
+    Logs into the output_file the info message
+    @param output_file the name of the output file 
+    @param ... The message to be logged
+*/
+#define zflog_info(output_file, ...)    _zflog(output_file,  L_INFO,      ##__VA_ARGS__)
+/*!
+    Logs to the sinks of a logger the info message
+    @param logger the logger
+    @param ... The message to be logged
+*/
+#define zlogger_info(logger, ...)       _zlogger(logger, L_INFO, ##__VA_ARGS__)
+#else
+#define zlog_info(...)                  _zlog_disabled(__VA_ARGS__)
+#define zflog_info(output_file, ...)    _zflog_disabled(output_file, __VA_ARGS__)
+#define zlogger_info(logger, ...)       _zlogger_disabled(logger, __VA_ARGS__)
+#endif
+
+#if ZLOG_ACTIVE_LEVEL <= ZLOG_LEVEL_WARNING
+/*!
+    Logs to the console the warning message
+    @param ... The message to be logged
+*/  
+#define zlog_warning(...)               _zlog(L_WARNING, ##__VA_ARGS__)
+/*!
     Logs into the output_file the warning message
     @param output_file the name of the output file 
     @param ... The message to be logged
 */
 #define zflog_warning(output_file, ...) _zflog(output_file,  L_WARNING,   ##__VA_ARGS__)
+/*!
+    Logs to the sinks of a logger the warning message
+    @param logger the logger
+    @param ... The message to be logged
+*/
+#define zlogger_warning(logger, ...)    _zlogger(logger, L_WARNING, ##__VA_ARGS__)
+#else
+#define zlog_warning(...)               _zlog_disabled(__VA_ARGS__)
+#define zflog_warning(output_file, ...) _zflog_disabled(output_file, __VA_ARGS__)
+#define zlogger_warning(logger, ...)    _zlogger_disabled(logger, __VA_ARGS__)
+#endif
+
+#if ZLOG_ACTIVE_LEVEL <= ZLOG_LEVEL_ERROR
+/*!
+    Logs to the console the error message
+    @param ... The message to be logged
+*/  
+#define zlog_error(...)                 _zlog(L_ERROR,   ##__VA_ARGS__)
 /*!
     Logs into the output_file the error message
     @param output_file the name of the output file 
     @param ... The message to be logged
 */
 #define zflog_error(output_file, ...)   _zflog(output_file,  L_ERROR,     ##__VA_ARGS__)
+/*!
+    Logs to the sinks of a logger the error message
+    @param logger the logger
+    @param ... The message to be logged
+*/
+#define zlogger_error(logger, ...)      _zlogger(logger, L_ERROR, ##__VA_ARGS__)
+#else
+#define zlog_error(...)                 _zlog_disabled(__VA_ARGS__)
+#define zflog_error(output_file, ...)   _zflog_disabled(output_file, __VA_ARGS__)
+#define zlogger_error(logger, ...)      _zlogger_disabled(logger, __VA_ARGS__)
+#endif
+
+#if ZLOG_ACTIVE_LEVEL <= ZLOG_LEVEL_FATAL
+/*!
+    Logs to the console the fatal message
+    @param ... The message to be logged
+*/  
+#define zlog_fatal(...)                 _zlog(L_FATAL,   ##__VA_ARGS__)
 /*!
     Logs into the output_file the fatal message
     @param output_file the name of the output file 
     @param ... The message to be logged
 */
 #define zflog_fatal(output_file, ...)   _zflog(output_file,  L_FATAL,     ##__VA_ARGS__)
+/*!
+    Logs to the sinks of a logger the fatal message
+    @param logger the logger
+    @param ... The message to be logged
+*/
+#define zlogger_fatal(logger, ...)      _zlogger(logger, L_FATAL, ##__VA_ARGS__)
+#else
+#define zlog_fatal(...)                 _zlog_disabled(__VA_ARGS__)
+#define zflog_fatal(output_file, ...)   _zflog_disabled(output_file, __VA_ARGS__)
+#define zlogger_fatal(logger, ...)      _zlogger_disabled(logger, __VA_ARGS__)
+#endif
 
 #endif /* ZLOG_H_ */
 
@@ -367,327 +991,5387 @@ void zlog_(const char* filename, size_t line, const char* fun_name, const char*
 #include <stdlib.h>
 #include <time.h>
 #include <stdarg.h>
+#include <string.h>
+#include <stddef.h>
+#include <wchar.h>
+
+zlogger zlog;
 
 #if defined _WIN32 
-void set_color(int color){
-    SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE),color);
-    return;
-}
+#include <Windows.h>
+
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
 #endif
 
-static uint8_t zlog_get_flag(){
-    return zlog.flags;
+/*
+    Enables the ansi escape sequences on the console
+*/
+
+static void zlog_enable_console_colors(){
+
+    HANDLE handles[] = { GetStdHandle(STD_OUTPUT_HANDLE), GetStdHandle(STD_ERROR_HANDLE) };
+
+    for(int i = 0; i < 2; i++){
+        DWORD mode = 0;
+        if(handles[i] != INVALID_HANDLE_VALUE && GetConsoleMode(handles[i], &mode)){
+            SetConsoleMode(handles[i], mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+        }
+    }
+
 }
+#endif
 
-static void zlog_set_flags(LogFlags flags){
+/*
+    Mutex used to guard the state shared between threads
+*/
+
+#if defined _WIN32
+    typedef SRWLOCK LogMutex;
+    #define ZLOG_MUTEX_INIT SRWLOCK_INIT
+    #define zlog_mutex_init(mutex) InitializeSRWLock(mutex)
+    #define zlog_mutex_destroy(mutex) ((void)(mutex))
+    #define zlog_mutex_lock(mutex) AcquireSRWLockExclusive(mutex)
+    #define zlog_mutex_unlock(mutex) ReleaseSRWLockExclusive(mutex)
+#else
+    #include <pthread.h>
+    typedef pthread_mutex_t LogMutex;
+    #define ZLOG_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+    #define zlog_mutex_init(mutex) pthread_mutex_init(mutex, NULL)
+    #define zlog_mutex_destroy(mutex) pthread_mutex_destroy(mutex)
+    #define zlog_mutex_lock(mutex) pthread_mutex_lock(mutex)
+    #define zlog_mutex_unlock(mutex) pthread_mutex_unlock(mutex)
+#endif
+
+/*
+    Allocator of the library, define them before including the implementation to use another one
+*/
+
+#ifndef ZLOG_MALLOC
+#define ZLOG_MALLOC(size) malloc(size)
+#endif
+
+#ifndef ZLOG_REALLOC
+#define ZLOG_REALLOC(ptr, size) realloc(ptr, size)
+#endif
+
+#ifndef ZLOG_FREE
+#define ZLOG_FREE(ptr) free(ptr)
+#endif
 
-    zlog.flags |= (uint8_t)flags;
+static atomic_size_t zlog_allocations;
+
+static void* zlog_malloc(size_t size){
+
+    atomic_fetch_add_explicit(&zlog_allocations, 1, memory_order_relaxed);
+
+    return ZLOG_MALLOC(size);
 
 }
 
-static void zlog_unset_flags(LogFlags flags){
+static void* zlog_calloc(size_t count, size_t size){
 
-    zlog.flags &= ~(uint8_t)flags;
+    if(size && count > SIZE_MAX / size) return NULL;
+
+    void *ptr = zlog_malloc(count * size);
+    if(ptr) memset(ptr, 0, count * size);
+
+    return ptr;
 
 }
 
-static void zlog_flip_flags(LogFlags flags){
+static void* zlog_realloc(void* ptr, size_t size){
+
+    atomic_fetch_add_explicit(&zlog_allocations, 1, memory_order_relaxed);
 
-    zlog.flags ^= (uint8_t)flags;
+    return ZLOG_REALLOC(ptr, size);
 
 }
 
-static void zlog_set_level(LogLevel level){
-    zlog.level = level;
+#define zlog_free(ptr) ZLOG_FREE(ptr)
+
+size_t zlog_allocation_count(){
+    return atomic_load_explicit(&zlog_allocations, memory_order_relaxed);
 }
 
-static void zlog_set_file_write_mode(const char * mode){
-    zlog.mode = mode;
+/*!
+    Log file opened by the zflog macros and kept open to be reused by the next calls
+
+    @param path the path of the file, used as key of the registry
+    @param stream the open stream of the file
+    @param next the next file of the registry
+*/
+typedef struct LogFileSink {
+
+    char * path;
+    FILE * stream;
+    struct LogFileSink * next;
+
+}LogFileSink;
+
+static LogMutex zlog_files_lock = ZLOG_MUTEX_INIT;
+static LogFileSink * zlog_files = NULL;
+
+/*!
+    Function that returns the stream of a log file, the file is opened only by the first call 
+    @param path the path of the file
+    @return the stream of the file or NULL if the file couldn't be opened
+*/
+
+static FILE* zlog_file_sink(const char* path){
+
+    zlog_mutex_lock(&zlog_files_lock);
+
+    LogFileSink *sink = zlog_files;
+
+    while(sink && strcmp(sink->path, path) != 0){
+        sink = sink->next;
+    }
+
+    if(!sink){
+
+        FILE *fp = fopen(path, atomic_load(&zlog.mode));
+        sink = fp ? (LogFileSink*)zlog_malloc(sizeof(LogFileSink)) : NULL;
+        char *copy = sink ? (char*)zlog_malloc(strlen(path) + 1) : NULL;
+
+        if(!copy){
+            if(fp) fclose(fp);
+            zlog_free(sink);
+            zlog_mutex_unlock(&zlog_files_lock);
+            fprintf(stderr, "[ERROR] Couldn't open file: %s\n", path);
+            return NULL;
+        }
+
+        strcpy(copy, path);
+
+        sink->path = copy;
+        sink->stream = fp;
+        sink->next = zlog_files;
+        zlog_files = sink;
+
+    }
+
+    zlog_mutex_unlock(&zlog_files_lock);
+
+    return sink->stream;
+
 }
 
-static void zlog_open_file(const char* filename){
+static void zlog_async_wait();
+static void zlog_sink_flush(const LogSink* sink);
+static void zlog_read_begin();
+static void zlog_read_end();
+static void zlog_read_synchronize();
 
-    FILE *fp = fopen(filename, zlog.mode);
+void zlogger_flush(zlogger* logger){
 
-    if(!fp){
-        zlog_fatal("Couldn't open file: %s", filename);
-        exit(1);
+    zlog_async_wait();
+
+    zlog_read_begin();
+    const LogSinkList *sinks = atomic_load(&logger->sinks);
+
+    for(size_t i = 0; sinks && i < sinks->count; i++){
+        zlog_sink_flush(&sinks->sinks[i]);
     }
 
-    zlog.Stream = fp;
+    zlog_read_end();
+
+}
+
+static void zlog_flush(){
+
+    zlogger_flush(&zlog);
 
-    if(CHECK_FLAG(ZLOG_BIT_USE_COLORS)){
-        zlog.unset_flags(ZLOG_USE_COLORS);
-        zlog.set_flags(ZLOG_CHECK_COLOR);
+    zlog_mutex_lock(&zlog_files_lock);
+
+    for(LogFileSink *sink = zlog_files; sink; sink = sink->next){
+        fflush(sink->stream);
     }
 
+    zlog_mutex_unlock(&zlog_files_lock);
+
 }
 
-static void zlog_close_stream(){
-    fclose(zlog.Stream);
-    zlog.Stream = stderr;
+/*!
+    Function that closes the files of the zflog macros: the registry is emptied first, 
+    the files are closed once the zflog calls that got their streams have ended and their records have been written
+*/
+
+static void zlog_close_files(){
+
+    zlog_mutex_lock(&zlog_files_lock);
+
+    LogFileSink *sink = zlog_files;
+    zlog_files = NULL;
+
+    zlog_mutex_unlock(&zlog_files_lock);
+
+    zlog_read_synchronize();
+    zlog_async_wait();
 
-    if(CHECK_FLAG(ZLOG_BIT_CHECK_COLOR)){
-        zlog.set_flags(ZLOG_USE_COLORS);
+    while(sink){
+        LogFileSink *next = sink->next;
+        fclose(sink->stream);
+        zlog_free(sink->path);
+        zlog_free(sink);
+        sink = next;
     }
+
 }
 
-static void zlog_set_output_stream(FILE* Stream){
+/*
+    Digits of the numbers from 00 to 99, the prefix fields are formatted two digits at a time without printf
+*/
 
-    zlog.Stream = Stream;
+static const char zlog_digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
 
+/*!
+    Function that formats a number from 0 to 99 on two digits
+    @param out the two characters written
+    @param value the number
+*/
+
+static inline void zlog_format_2digits(char* out, unsigned value){
+    memcpy(out, zlog_digit_pairs + value * 2, 2);
 }
 
-static void zlog_clear_file(const char* filename){
+/*!
+    Function that formats a number on a fixed number of digits, padded with zeros
+    @param out the characters written, width long
+    @param value the number, its most significant digits beyond width are dropped
+    @param width the number of digits
+*/
 
-    FILE *fp = fopen(filename, "w");
-    fclose(fp);
+static void zlog_format_fixed(char* out, uint32_t value, size_t width){
+
+    char *p = out + width;
+
+    while(p - out >= 2){
+        p -= 2;
+        zlog_format_2digits(p, value % 100);
+        value /= 100;
+    }
+
+    if(p > out) *--p = (char)('0' + value % 10);
 
 }
 
-static void zlog_set_pattern(char* pattern){
-    
-    zlog.pattern = pattern;
+/*!
+    Function that formats an unsigned number in decimal
+    @param out the characters written, at least 10 bytes
+    @param value the number
+    @return the number of characters written
+*/
+
+static size_t zlog_format_u32(char* out, uint32_t value){
+
+    char digits[10];
+    char *p = digits + sizeof(digits);
+
+    while(value >= 100){
+        p -= 2;
+        zlog_format_2digits(p, value % 100);
+        value /= 100;
+    }
+
+    if(value >= 10){
+        p -= 2;
+        zlog_format_2digits(p, value);
+    }else {
+        *--p = (char)('0' + value);
+    }
+
+    size_t length = (size_t)(digits + sizeof(digits) - p);
+    memcpy(out, p, length);
+
+    return length;
 
 }
 
-void zlog_init(const char* log_name){
+/*!
+    Function that formats an unsigned number of 64 bits in decimal
+    @param out the characters written, at least 20 bytes
+    @param value the number
+    @return the number of characters written
+*/
 
-    zlog.name = log_name;
-    zlog.level = L_INFO;
-    zlog.flags = ZLOG_ALL;
-    zlog.Stream = stderr;
-    zlog.mode = "a";
+static size_t zlog_format_u64(char* out, uint64_t value){
 
-    zlog.set_level = zlog_set_level;
-    zlog.set_file_write_mode = zlog_set_file_write_mode;
-    zlog.open_file = zlog_open_file;
-    zlog.clear_file = zlog_clear_file;
-    zlog.close_stream = zlog_close_stream;
-    zlog.set_output_stream = zlog_set_output_stream;
-    zlog.get_flags = zlog_get_flag;
-    zlog.set_flags = zlog_set_flags;
-    zlog.unset_flags = zlog_unset_flags;
-    zlog.flip_flags = zlog_flip_flags;
-    zlog.set_pattern = zlog_set_pattern;
+    if(value <= UINT32_MAX) return zlog_format_u32(out, (uint32_t)value);
+
+    char digits[20];
+    char *p = digits + sizeof(digits);
+
+    while(value > UINT32_MAX){
+        p -= 2;
+        zlog_format_2digits(p, (unsigned)(value % 100));
+        value /= 100;
+    }
+
+    size_t head = zlog_format_u32(out, (uint32_t)value);
+    size_t tail = (size_t)(digits + sizeof(digits) - p);
+    memcpy(out + head, p, tail);
+
+    return head + tail;
 
-    zlog.set_pattern("{D}/{M}/{Y} {h}:{m}:{s} | {f} @ {l} | {n} | {t} > ");
- 
 }
 
-static void zlog_log_pattern(const char * filename, const char* fun_name, size_t line){
+/*!
+    Function that formats a year on 4 digits, the years outside 0..9999 are written with all their digits
+    @param out the characters written, at least 11 bytes
+    @param year the year
+    @return the number of characters written
+*/
+
+static size_t zlog_format_year(char* out, int year){
 
-    time_t t = time(NULL);
-    struct tm tm = *localtime(&t);
+    if(year >= 0 && year <= 9999){
+        zlog_format_fixed(out, (uint32_t)year, 4);
+        return 4;
+    }
 
-    char * pattern = zlog.pattern;
+    if(year < 0){
+        *out = '-';
+        return 1 + zlog_format_u32(out + 1, (uint32_t)0 - (uint32_t)year);
+    }
 
-    while(*pattern){
+    return zlog_format_u32(out, (uint32_t)year);
 
-        if(*pattern == '{'){
+}
 
-            pattern++;
+/*
+    Storage class of the per thread caches
+*/
 
-            if(*pattern == 'D'){
+#if defined _MSC_VER
+#define ZLOG_THREAD_LOCAL __declspec(thread)
+#else
+#define ZLOG_THREAD_LOCAL _Thread_local
+#endif
 
-                pattern++;
+/*!
+    Date and time fields rendered once per second and reused by every record logged in that second.
+    The cache is per thread, so it is read and refreshed without any lock.
 
-                if(CHECK_FLAG(ZLOG_BIT_USE_COLORS)){
-                    #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-                        fprintf(zlog.Stream, "%s", ANSI_COLOR_YELLOW);
-                    #elif _WIN32 
-                        set_color(C_Yellow);
-                    #endif
-                }
+    @param second the civil second (UTC or local) the fields have been rendered for, -1 if the cache is empty
+    @param fields the rendered text of the fields from DAY to SECOND
+    @param lengths the length of every rendered field
+*/
+typedef struct {
 
-                if(tm.tm_mday < 10){
-                    fprintf(zlog.Stream, "0%d", tm.tm_mday);
-                }else{
-                    fprintf(zlog.Stream, "%d", tm.tm_mday);
-                }
+    time_t second;
+    char fields[SECOND + 1][12];
+    uint8_t lengths[SECOND + 1];
 
-            }else if(*pattern == 'M'){
-                
-                pattern++;
+}LogTimeCache;
 
-                if(CHECK_FLAG(ZLOG_BIT_USE_COLORS)){
-                    #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-                        fprintf(zlog.Stream, "%s", ANSI_COLOR_YELLOW);
-                    #elif _WIN32 
-                        set_color(C_Yellow);
-                    #endif
-                }
+static ZLOG_THREAD_LOCAL LogTimeCache zlog_time_cache = { (time_t)-1, { { 0 } }, { 0 } };
 
-                if(tm.tm_mon < 10){
-                    fprintf(zlog.Stream, "0%d", tm.tm_mon + 1);
-                }else{
-                    fprintf(zlog.Stream, "%d", tm.tm_mon + 1);
-                }
+/*!
+    Function that reads the wall clock without taking any lock 
+    @return the current time in seconds
+*/
 
-            }else if(*pattern == 'Y'){
-                
-                pattern++;
+static time_t zlog_clock_seconds(){
 
-                if(CHECK_FLAG(ZLOG_BIT_USE_COLORS)){
-                    #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-                        fprintf(zlog.Stream, "%s", ANSI_COLOR_YELLOW);
-                    #elif _WIN32 
-                        set_color(C_Yellow);
-                    #endif
-                }
+    #if defined (CLOCK_REALTIME_COARSE)
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+        return ts.tv_sec;
+    #else
+        return time(NULL);
+    #endif
 
-                fprintf(zlog.Stream, "%d", tm.tm_year + 1900);
+}
 
-            }else if(*pattern == 'h'){
-                
-                pattern++;
+/*
+    Nanoseconds between two calibrations of the monotonic and the tsc clocks
+*/
 
-                if(CHECK_FLAG(ZLOG_BIT_USE_COLORS)){
-                    #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-                        fprintf(zlog.Stream, "%s", ANSI_COLOR_YELLOW);
-                    #elif _WIN32 
-                        set_color(C_Yellow);
-                    #endif
-                }
+#ifndef ZLOG_CLOCK_CALIBRATION_NS
+#define ZLOG_CLOCK_CALIBRATION_NS 1000000000
+#endif
 
-                if(tm.tm_hour < 10){
-                    fprintf(zlog.Stream, "0%d", tm.tm_hour);
-                }else{
-                    fprintf(zlog.Stream, "%d", tm.tm_hour);
-                }
+/*
+    Microseconds the tsc is measured against the wall clock by its first calibration
+*/
 
-            }else if(*pattern == 'm'){
-                
-                pattern++;
+#ifndef ZLOG_TSC_CALIBRATION_US
+#define ZLOG_TSC_CALIBRATION_US 10000
+#endif
 
-                if(CHECK_FLAG(ZLOG_BIT_USE_COLORS)){
-                    #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-                        fprintf(zlog.Stream, "%s", ANSI_COLOR_YELLOW);
-                    #elif _WIN32 
-                        set_color(C_Yellow);
-                    #endif
-                }
+#if defined __x86_64__ || defined __i386__ || defined _M_X64 || defined _M_IX86
+    #if defined _MSC_VER
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+    #define ZLOG_HAS_TSC 1
+    #define zlog_tsc_read() ((uint64_t)__rdtsc())
+#elif defined __aarch64__
+    static inline uint64_t zlog_tsc_read(){
+        uint64_t ticks;
+        __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+        return ticks;
+    }
+    #define ZLOG_HAS_TSC 1
+#else
+    #define ZLOG_HAS_TSC 0
+#endif
 
-                if(tm.tm_min < 10){
-                    fprintf(zlog.Stream, "0%d", tm.tm_min);
-                }else{
-                    fprintf(zlog.Stream, "%d", tm.tm_min);
-                }
+/*!
+    Conversion of the raw ticks of a clock to wall time: wall + (ticks - calibration ticks) * scale.
+    The binary files store it, so the decoder converts the ticks of the records
 
-            }else if(*pattern == 's'){
-                
-                pattern++;
+    @param ticks the ticks read at the calibration
+    @param wall the wall time at the calibration in nanoseconds since the epoch
+    @param scale the nanoseconds per tick in 32.32 fixed point
+*/
+typedef struct {
 
-                if(CHECK_FLAG(ZLOG_BIT_USE_COLORS)){
-                    #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-                        fprintf(zlog.Stream, "%s", ANSI_COLOR_YELLOW);
-                    #elif _WIN32 
-                        set_color(C_Yellow);
-                    #endif
-                }
+    uint64_t ticks;
+    int64_t wall;
+    uint64_t scale;
 
-                if(tm.tm_sec < 10){
-                    fprintf(zlog.Stream, "0%d", tm.tm_sec);
-                }else{
-                    fprintf(zlog.Stream, "%d", tm.tm_sec);
-                }
+}LogClockCalibration;
 
-            }else if(*pattern == 'f'){
-                
-                pattern++;
+/*!
+    Calibration of a clock shared by the threads, read with a sequence lock (sequentially consistent, it is written once per period)
+
+    @param sequence the version of the calibration, odd while it is written and 0 until the clock is calibrated
+    @param calibrating whether a thread is calibrating the clock
+    @param ticks the ticks read at the calibration
+    @param wall the wall time at the calibration in nanoseconds since the epoch
+    @param scale the nanoseconds per tick in 32.32 fixed point
+    @param period the ticks between two calibrations
+*/
+typedef struct {
 
-                if(CHECK_FLAG(ZLOG_BIT_USE_COLORS)){
-                    #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-                        fprintf(zlog.Stream, "%s", ANSI_COLOR_MAGENTA);
-                    #elif _WIN32 
-                        set_color(C_Magenta);
-                    #endif
-                }
+    _Atomic(uint64_t) sequence;
+    atomic_int calibrating;
+    _Atomic(uint64_t) ticks;
+    _Atomic(int64_t) wall;
+    _Atomic(uint64_t) scale;
+    _Atomic(uint64_t) period;
 
-                fprintf(zlog.Stream, "%s", fun_name);
+}LogClockState;
 
-            }else if(*pattern == 'l'){
-                
-                pattern++;
+static LogClockState zlog_clocks[ZLOG_CLOCK_TSC + 1];
 
-                if(CHECK_FLAG(ZLOG_BIT_USE_COLORS)){
-                    #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-                        fprintf(zlog.Stream, "%s", ANSI_COLOR_MAGENTA);
-                    #elif _WIN32 
-                        set_color(C_Magenta);
-                    #endif
-                }
+#define ZLOG_CLOCK_UNIT_SCALE ((uint64_t)1 << 32)
 
-                fprintf(zlog.Stream, "%s:%zu", filename, line);
+/*!
+    Function that reads the monotonic clock
+    @return the monotonic time in nanoseconds
+*/
 
-            }else if(*pattern == 'n'){
-                
-                pattern++;
+static uint64_t zlog_monotonic_ns(){
 
-                if(CHECK_FLAG(ZLOG_BIT_USE_COLORS)){
-                    #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-                        fprintf(zlog.Stream, "%s", ANSI_COLOR_MAGENTA);
-                    #elif _WIN32 
-                        set_color(C_Magenta);
-                    #endif
-                }
+    #if defined _WIN32
+        LARGE_INTEGER frequency, counter;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&counter);
+        return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+    #else
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+    #endif
 
-                fprintf(zlog.Stream, "%s", zlog.name);
+}
 
-            }else if(*pattern == 't'){
-                
-                pattern++;
+static int64_t zlog_realtime_ns(){
 
-                if(CHECK_FLAG(ZLOG_BIT_USE_COLORS)){
-                    #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-                        fprintf(zlog.Stream, "%s", log_color[zlog.level]);
-                    #elif _WIN32  
-                        set_color(log_color[zlog.level]);  
-                    #endif
-                }
+    struct timespec now;
 
-                fprintf(zlog.Stream, "[%s]", log_tag[zlog.level]);
+    #if defined _WIN32
+        timespec_get(&now, TIME_UTC);
+    #else
+        clock_gettime(CLOCK_REALTIME, &now);
+    #endif
 
-            }
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
 
-            if(*pattern != '}'){
-                set_color(C_Red);
-                fprintf(stderr, "[FATAL]");
-                set_color(C_White);
-                fprintf(stderr, " Invalid pattern: missing closing bracket in %s @ %s:%zu", fun_name, filename, line);
-                exit(1);
-            }
+}
 
-        }else {
+/*!
+    Function that reads the raw ticks of a clock: nanoseconds since the epoch for the realtime clocks, 
+    nanoseconds of the monotonic clock or the tsc counter
+    @param clock the clock
+    @return the ticks
+*/
 
-            fwrite(pattern, 1, 1, zlog.Stream);
+static uint64_t zlog_clock_ticks(LogClockSource clock){
 
-        }
+    switch(clock){
+
+        case ZLOG_CLOCK_REALTIME:
+            return (uint64_t)zlog_realtime_ns();
 
-        pattern++;
+        case ZLOG_CLOCK_COARSE: {
+            #if defined (CLOCK_REALTIME_COARSE)
+                struct timespec now;
+                clock_gettime(CLOCK_REALTIME_COARSE, &now);
+                return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+            #else
+                return (uint64_t)zlog_realtime_ns();
+            #endif
+        }
 
-        #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
-            fprintf(zlog.Stream, "%s", ANSI_COLOR_RESET);
-        #elif _WIN32  
-            set_color(C_White);  
+        #if ZLOG_HAS_TSC
+        case ZLOG_CLOCK_TSC:
+            return zlog_tsc_read();
         #endif
 
+        default:
+            return zlog_monotonic_ns();
+
     }
 
 }
 
+/*!
+    Function that reads the calibration of a clock, the realtime clocks don't need one
+    @param clock the clock
+    @param calibration the calibration
+    @return the version of the calibration, 0 if the clock has not been calibrated
+*/
 
-void zlog_(const char * filename, size_t line, const char * fun_name, const char* fmt, ...){
-    
-    if(!(CHECK_FLAG(ZLOG_BIT_DEBUG)) && zlog.level == L_DEBUG) return;
+static uint64_t zlog_clock_calibration(LogClockSource clock, LogClockCalibration* calibration){
 
-    zlog_log_pattern(filename, fun_name, line);
+    if(clock == ZLOG_CLOCK_REALTIME || clock == ZLOG_CLOCK_COARSE){
+        *calibration = (LogClockCalibration){ 0, 0, ZLOG_CLOCK_UNIT_SCALE };
+        return 1;
+    }
+
+    LogClockState *state = &zlog_clocks[clock];
+    uint64_t sequence;
+
+    do {
+        sequence = atomic_load(&state->sequence);
+        calibration->ticks = atomic_load(&state->ticks);
+        calibration->wall = atomic_load(&state->wall);
+        calibration->scale = atomic_load(&state->scale);
+    } while((sequence & 1) || sequence != atomic_load(&state->sequence));
+
+    return sequence;
+
+}
+
+/*!
+    Function that reads the ticks of a clock and the wall time at the same instant, 
+    the wall clock is read between two reads of the ticks
+    @param clock the clock
+    @param ticks the ticks
+    @param wall the wall time in nanoseconds since the epoch
+*/
+
+static void zlog_clock_sample(LogClockSource clock, uint64_t* ticks, int64_t* wall){
+
+    uint64_t before = zlog_clock_ticks(clock);
+    *wall = zlog_realtime_ns();
+    uint64_t after = zlog_clock_ticks(clock);
+
+    *ticks = before + (after - before) / 2;
+
+}
+
+/*!
+    Function that calibrates a clock against the wall clock, so that the steps of the wall clock are followed.
+    The scale of the tsc is measured between its last two calibrations, 
+    a scale that changes by more than 1/64 (a step of the wall clock) is discarded
+    @param clock the clock
+*/
+
+static void zlog_clock_calibrate(LogClockSource clock){
+
+    LogClockState *state = &zlog_clocks[clock];
+    uint64_t ticks;
+    int64_t wall;
+    uint64_t scale = ZLOG_CLOCK_UNIT_SCALE;
+    uint64_t period = ZLOG_CLOCK_CALIBRATION_NS;
+
+    zlog_clock_sample(clock, &ticks, &wall);
+
+    if(clock == ZLOG_CLOCK_TSC){
+
+        uint64_t previous_ticks = atomic_load_explicit(&state->ticks, memory_order_relaxed);
+        int64_t previous_wall = atomic_load_explicit(&state->wall, memory_order_relaxed);
+        uint64_t previous_scale = atomic_load_explicit(&state->scale, memory_order_relaxed);
+
+        if(atomic_load_explicit(&state->sequence, memory_order_relaxed) == 0){
+
+            previous_ticks = ticks;
+            previous_wall = wall;
+            previous_scale = 0;
+
+            uint64_t start = zlog_monotonic_ns();
+            while(zlog_monotonic_ns() - start < (uint64_t)ZLOG_TSC_CALIBRATION_US * 1000);
+
+            zlog_clock_sample(clock, &ticks, &wall);
+
+        }
+
+        scale = previous_scale;
+
+        if(ticks > previous_ticks && wall > previous_wall){
+
+            uint64_t measured = (uint64_t)((double)(wall - previous_wall) / (double)(ticks - previous_ticks) * (double)ZLOG_CLOCK_UNIT_SCALE);
+            uint64_t deviation = measured > previous_scale ? measured - previous_scale : previous_scale - measured;
+
+            if(previous_scale == 0 || deviation <= previous_scale / 64) scale = measured;
+
+        }
+
+        if(scale == 0) scale = ZLOG_CLOCK_UNIT_SCALE;
+
+        period = (uint64_t)((double)ZLOG_CLOCK_CALIBRATION_NS * (double)ZLOG_CLOCK_UNIT_SCALE / (double)scale);
+
+    }
+
+    uint64_t sequence = atomic_load_explicit(&state->sequence, memory_order_relaxed);
+
+    atomic_store(&state->sequence, sequence + 1);
+
+    atomic_store(&state->ticks, ticks);
+    atomic_store(&state->wall, wall);
+    atomic_store(&state->scale, scale);
+    atomic_store(&state->period, period);
+
+    atomic_store(&state->sequence, sequence + 2);
+
+}
+
+/*!
+    Function that converts the ticks of a clock to wall time with a calibration
+    @param calibration the calibration
+    @param ticks the ticks
+    @return the wall time
+*/
+
+static struct timespec zlog_clock_convert(const LogClockCalibration* calibration, uint64_t ticks){
+
+    int64_t delta = (int64_t)(ticks - calibration->ticks);
+
+    if(calibration->scale != ZLOG_CLOCK_UNIT_SCALE){
+        delta = (int64_t)((double)delta * (double)calibration->scale / (double)ZLOG_CLOCK_UNIT_SCALE);
+    }
+
+    int64_t wall = calibration->wall + delta;
+
+    return (struct timespec){ (time_t)(wall / 1000000000), (long)(wall % 1000000000) };
+
+}
+
+/*!
+    Function that converts the ticks of a clock to wall time, 
+    the clock is calibrated by the first call and again every ZLOG_CLOCK_CALIBRATION_NS by the thread that notices it
+    @param clock the clock
+    @param ticks the ticks
+    @return the wall time
+*/
+
+static struct timespec zlog_clock_wall(LogClockSource clock, uint64_t ticks){
+
+    LogClockCalibration calibration;
+    uint64_t sequence = zlog_clock_calibration(clock, &calibration);
+
+    if(clock == ZLOG_CLOCK_MONOTONIC || clock == ZLOG_CLOCK_TSC){
+
+        LogClockState *state = &zlog_clocks[clock];
+
+        if(sequence == 0 || (int64_t)(ticks - calibration.ticks) >= (int64_t)atomic_load_explicit(&state->period, memory_order_relaxed)){
+
+            if(!atomic_exchange_explicit(&state->calibrating, 1, memory_order_acquire)){
+                zlog_clock_calibrate(clock);
+                atomic_store_explicit(&state->calibrating, 0, memory_order_release);
+            }
+
+            while((sequence = zlog_clock_calibration(clock, &calibration)) == 0);
+
+        }
+
+    }
+
+    return zlog_clock_convert(&calibration, ticks);
+
+}
+
+/*!
+    Function that reads the precise wall clock used by the sub-second fields, the asynchronous and the binary records
+    @param clock the clock of the logger
+    @return the current time
+*/
+
+static struct timespec zlog_clock_now(LogClockSource clock){
+    return zlog_clock_wall(clock, zlog_clock_ticks(clock));
+}
+
+/*
+    Thread and cpu of the records, not stored in the binary files: the decoder renders them as "-"
+*/
+
+#ifndef ZLOG_DECODER
+
+#if defined __linux__
+    #include <unistd.h>
+    #include <sched.h>
+    #include <sys/syscall.h>
+    /* whether the GNU extensions (gettid(), sched_getcpu()) and syscall() have been declared by the C library */
+    #if defined __USE_GNU || (!defined __GLIBC__ && defined _GNU_SOURCE)
+        #define ZLOG_LINUX_GNU 1
+    #else
+        #define ZLOG_LINUX_GNU 0
+    #endif
+    #if ZLOG_LINUX_GNU || defined __USE_MISC || (!defined __GLIBC__ && defined _BSD_SOURCE)
+        #define ZLOG_LINUX_SYSCALL 1
+    #else
+        #define ZLOG_LINUX_SYSCALL 0
+    #endif
+    #if ZLOG_LINUX_GNU && defined __GLIBC__
+        #if __GLIBC_PREREQ(2, 30)
+            #define ZLOG_LINUX_GETTID 1
+        #endif
+    #endif
+#elif defined __APPLE__
+    #include <pthread.h>
+#endif
+
+/*!
+    Id of the calling thread, rendered in decimal by the first record of the thread
+
+    @param length the length of the rendered id, 0 until the first record
+    @param text the rendered id
+*/
+typedef struct {
+
+    uint8_t length;
+    char text[20];
+
+}LogThreadId;
+
+static ZLOG_THREAD_LOCAL LogThreadId zlog_thread_id;
+
+/*!
+    Function that returns the id of the calling thread given by the operating system, 
+    fetched once per thread and kept rendered, so printing it is a copy
+    @return the rendered id
+*/
+
+static const LogThreadId* zlog_current_thread_id(){
+
+    LogThreadId *id = &zlog_thread_id;
+
+    if(id->length) return id;
+
+    uint64_t value;
+
+    #if defined _WIN32
+        value = (uint64_t)GetCurrentThreadId();
+    #elif defined __linux__ && defined ZLOG_LINUX_GETTID
+        value = (uint64_t)gettid();
+    #elif defined __linux__ && ZLOG_LINUX_SYSCALL && defined SYS_gettid
+        value = (uint64_t)syscall(SYS_gettid);
+    #elif defined __APPLE__
+        pthread_threadid_np(NULL, &value);
+    #else
+        value = (uint64_t)(uintptr_t)pthread_self();
+    #endif
+
+    id->length = (uint8_t)zlog_format_u64(id->text, value);
+
+    return id;
+
+}
+
+#if defined __linux__ && !ZLOG_LINUX_GNU && ZLOG_LINUX_SYSCALL && defined SYS_getcpu
+    #define ZLOG_CPU_SYSCALL
+#endif
+
+#ifdef ZLOG_CPU_SYSCALL
+
+/*
+    Number of records of a thread that reuse the cpu read by the getcpu system call, 
+    when sched_getcpu() is not declared
+*/
+
+#ifndef ZLOG_CPU_REFRESH
+#define ZLOG_CPU_REFRESH 64
+#endif
+
+/*!
+    Cpu read by the last getcpu system call of the thread
+
+    @param cpu the cpu or -1 if it is not available
+    @param uses the records left before the next system call
+*/
+typedef struct {
+
+    int cpu;
+    unsigned uses;
+
+}LogThreadCpu;
+
+static ZLOG_THREAD_LOCAL LogThreadCpu zlog_thread_cpu;
+
+#endif
+
+/*!
+    Function that returns the cpu the calling thread is running on, without a system call: 
+    sched_getcpu() reads it from the vDSO or from the rseq area of the thread. 
+    Without the GNU extensions the cpu is read with the getcpu system call once every ZLOG_CPU_REFRESH records of the thread, 
+    the records in between print the last cpu read
+    @return the cpu or -1 if it is not available
+*/
+
+static int zlog_current_cpu(){
+
+    #if defined _WIN32
+        return (int)GetCurrentProcessorNumber();
+    #elif defined __linux__ && ZLOG_LINUX_GNU
+        return sched_getcpu();
+    #elif defined ZLOG_CPU_SYSCALL
+        LogThreadCpu *cached = &zlog_thread_cpu;
+        if(cached->uses == 0){
+            unsigned cpu;
+            cached->cpu = syscall(SYS_getcpu, &cpu, NULL, NULL) == 0 ? (int)cpu : -1;
+            cached->uses = ZLOG_CPU_REFRESH;
+        }
+        cached->uses--;
+        return cached->cpu;
+    #else
+        return -1;
+    #endif
+
+}
+
+#endif /* ZLOG_DECODER */
+
+/*!
+    Function that returns the days since 1970-01-01 of a date of the proleptic gregorian calendar
+    @param year the year
+    @param month the month, from 1 to 12
+    @param day the day of the month, from 1 to 31
+    @return the days since the epoch
+*/
+
+static int64_t zlog_days_from_civil(int64_t year, unsigned month, unsigned day){
+
+    year -= month <= 2;
+
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    unsigned year_of_era = (unsigned)(year - era * 400);
+    unsigned day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+    return era * 146097 + (int64_t)day_of_era - 719468;
+
+}
+
+/*!
+    Function that returns the date of the proleptic gregorian calendar of the days since 1970-01-01, 
+    the inverse of zlog_days_from_civil()
+    @param days the days since the epoch
+    @param year the year
+    @param month the month, from 1 to 12
+    @param day the day of the month, from 1 to 31
+*/
+
+static void zlog_civil_from_days(int64_t days, int64_t* year, unsigned* month, unsigned* day){
+
+    days += 719468;
+
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned day_of_era = (unsigned)(days - era * 146097);
+    unsigned year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    unsigned day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    unsigned shifted_month = (5 * day_of_year + 2) / 153;
+
+    *day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+    *month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+    *year = (int64_t)year_of_era + era * 400 + (*month <= 2);
+
+}
+
+/*
+    Seconds of UTC the local offset is cached for: the offsets of the time zones are multiples of 15 minutes, 
+    so their transitions fall on a quarter of an hour of UTC
+*/
+
+#define ZLOG_LOCAL_OFFSET_PERIOD 900
+
+/*!
+    Offset of the local time from UTC shared by the threads: the quarter of an hour of UTC it has been read for + 1 
+    in the high 32 bits, 0 if it has never been read, and the offset in seconds in the low 32 bits
+*/
+
+static _Atomic(uint64_t) zlog_local_offset_cache;
+
+/*!
+    Function that returns the offset of the local time from UTC. The offset changes only on a quarter of an hour of UTC 
+    (daylight saving time), so localtime() is called by the first record of every quarter, not by every thread
+    @param second the time in seconds
+    @return the offset in seconds
+*/
+
+static int32_t zlog_local_offset(time_t second){
+
+    int64_t quarter = (int64_t)second / ZLOG_LOCAL_OFFSET_PERIOD - ((int64_t)second % ZLOG_LOCAL_OFFSET_PERIOD < 0);
+    uint32_t key = (uint32_t)(quarter + 1);
+    uint64_t cached = atomic_load_explicit(&zlog_local_offset_cache, memory_order_relaxed);
+
+    if((uint32_t)(cached >> 32) == key && cached != 0) return (int32_t)(uint32_t)cached;
+
+    struct tm tm;
+
+    #if defined _WIN32
+        localtime_s(&tm, &second);
+    #else
+        localtime_r(&second, &tm);
+    #endif
+
+    int64_t local = zlog_days_from_civil((int64_t)tm.tm_year + 1900, (unsigned)tm.tm_mon + 1, (unsigned)tm.tm_mday) * 86400 + 
+                    tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+    int32_t offset = (int32_t)(local - (int64_t)second);
+
+    atomic_store_explicit(&zlog_local_offset_cache, ((uint64_t)key << 32) | (uint32_t)offset, memory_order_relaxed);
+
+    return offset;
+
+}
+
+/*!
+    Function that returns the date and time fields for the given second, 
+    they are rendered only when the second changes
+    @param second the time in seconds
+    @param utc whether the fields are in UTC instead of the local time
+    @return the cache of the calling thread
+*/
+
+static const LogTimeCache* zlog_time_fields(time_t second, int utc){
+
+    LogTimeCache *cache = &zlog_time_cache;
+    int64_t civil = (int64_t)second + (utc ? 0 : zlog_local_offset(second));
+
+    if((int64_t)cache->second == civil) return cache;
+
+    int64_t days = civil / 86400 - (civil % 86400 < 0);
+    int64_t seconds_of_day = civil - days * 86400;
+    int64_t year;
+    unsigned month, day;
+
+    zlog_civil_from_days(days, &year, &month, &day);
+
+    const int values[SECOND + 1] = {
+        [DAY] = (int)day,
+        [MONTH] = (int)month,
+        [YEAR] = (int)year,
+        [HOUR] = (int)(seconds_of_day / 3600),
+        [MINUTE] = (int)(seconds_of_day / 60 % 60),
+        [SECOND] = (int)(seconds_of_day % 60)
+    };
+
+    for(int i = DAY; i <= SECOND; i++){
+        if(i == YEAR){
+            cache->lengths[i] = (uint8_t)zlog_format_year(cache->fields[i], values[i]);
+        }else {
+            zlog_format_2digits(cache->fields[i], (unsigned)values[i] % 100);
+            cache->lengths[i] = 2;
+        }
+    }
+
+    cache->second = (time_t)civil;
+
+    return cache;
+
+}
+
+/*
+    Size of the buffer on the stack used to render a record, 
+    bigger records are moved to the heap
+*/
+
+#ifndef ZLOG_RECORD_SIZE
+#define ZLOG_RECORD_SIZE 1024
+#endif
+
+/*
+    Max size of the formatting arena of a thread, the records that don't fit in it take the slow path
+*/
+
+#ifndef ZLOG_ARENA_MAX_SIZE
+#define ZLOG_ARENA_MAX_SIZE (64 * 1024)
+#endif
+
+/*
+    Max size of a record on the slow path, the longer records are truncated
+*/
+
+#ifndef ZLOG_RECORD_MAX_SIZE
+#define ZLOG_RECORD_MAX_SIZE (1024 * 1024)
+#endif
+
+/*!
+    Formatting arena of a thread, reused by every record the thread renders. It starts in thread local storage 
+    and moves to the heap when a record needs more, up to ZLOG_ARENA_MAX_SIZE, it never shrinks.
+    The heap storage is released when the thread exits (on Windows it is kept until the process exits)
+
+    @param data the storage, NULL until the first record
+    @param capacity the number of bytes that data can hold
+    @param initial the storage used until a record needs more
+*/
+typedef struct LogArena {
+
+    char * data;
+    size_t capacity;
+    char initial[ZLOG_RECORD_SIZE];
+
+}LogArena;
+
+/*
+    Arenas of the thread: the record without colors (also used by the binary records and the backtrace) and the colored one
+*/
+
+static ZLOG_THREAD_LOCAL LogArena zlog_arenas[2];
+
+#if !defined _WIN32
+
+static pthread_key_t zlog_arena_key;
+static pthread_once_t zlog_arena_once = PTHREAD_ONCE_INIT;
+
+static void zlog_arena_release(void* arenas){
+
+    for(int i = 0; i < 2; i++){
+        LogArena *arena = &((LogArena*)arenas)[i];
+        if(arena->data && arena->data != arena->initial) zlog_free(arena->data);
+        arena->data = NULL;
+    }
+
+}
+
+static void zlog_arena_create_key(){
+    pthread_key_create(&zlog_arena_key, zlog_arena_release);
+}
+
+#endif
+
+/*!
+    Function that registers the arenas of the thread to be released when it exits, 
+    called the first time an arena moves to the heap
+*/
+
+static void zlog_arena_register(){
+
+    #if !defined _WIN32
+        pthread_once(&zlog_arena_once, zlog_arena_create_key);
+        pthread_setspecific(zlog_arena_key, zlog_arenas);
+    #endif
+
+}
+
+/*!
+    Buffer where a whole record (prefix and message) is rendered before being written to the stream 
+
+    @param data the rendered bytes, points to stack, to the arena of the thread or to the heap
+    @param length the number of rendered bytes
+    @param capacity the number of bytes that data can hold
+    @param arena the arena of the thread the buffer is rendered in, NULL for the other buffers
+    @param bounded whether the buffer holds at most ZLOG_RECORD_MAX_SIZE bytes, the longer records are truncated
+    @param stack the inline storage used until the record fits in it
+*/
+typedef struct {
+
+    char * data;
+    size_t length;
+    size_t capacity;
+    LogArena * arena;
+    int bounded;
+    char stack[ZLOG_RECORD_SIZE];
+
+}LogBuffer;
+
+static void zlog_buffer_init(LogBuffer* buffer){
+    buffer->data = buffer->stack;
+    buffer->length = 0;
+    buffer->capacity = sizeof(buffer->stack);
+    buffer->arena = NULL;
+    buffer->bounded = 0;
+}
+
+/*!
+    Function that sets up a buffer rendered in an arena of the thread, 
+    a record that doesn't fit in ZLOG_ARENA_MAX_SIZE leaves the arena for the heap (the slow path)
+    @param buffer the buffer
+    @param arena the arena
+*/
+
+static void zlog_buffer_init_arena(LogBuffer* buffer, LogArena* arena){
+
+    if(!arena->data){
+        arena->data = arena->initial;
+        arena->capacity = sizeof(arena->initial);
+    }
+
+    buffer->data = arena->data;
+    buffer->length = 0;
+    buffer->capacity = arena->capacity;
+    buffer->arena = arena;
+    buffer->bounded = 1;
+
+}
+
+static void zlog_buffer_free(LogBuffer* buffer){
+    if(!buffer->arena && buffer->data != buffer->stack){
+        zlog_free(buffer->data);
+    }
+    zlog_buffer_init(buffer);
+}
+
+/*!
+    Function that makes room for other bytes in the buffer
+    @param buffer the buffer
+    @param size the number of bytes that will be appended 
+    @return 0 on success, -1 if the memory couldn't be allocated or the buffer would exceed ZLOG_RECORD_MAX_SIZE
+*/
+
+static int zlog_buffer_reserve(LogBuffer* buffer, size_t size){
+
+    if(buffer->length + size <= buffer->capacity) return 0;
+
+    if(buffer->bounded && buffer->length + size > ZLOG_RECORD_MAX_SIZE) return -1;
+
+    size_t capacity = buffer->capacity * 2;
+    while(capacity < buffer->length + size) capacity *= 2;
+
+    LogArena *arena = buffer->arena;
+
+    if(arena && capacity > ZLOG_ARENA_MAX_SIZE){
+        arena = NULL;
+    }
+
+    if(buffer->bounded && capacity > ZLOG_RECORD_MAX_SIZE){
+        capacity = ZLOG_RECORD_MAX_SIZE;
+    }
+
+    char *data = (char*)zlog_malloc(capacity);
+    if(!data) return -1;
+
+    memcpy(data, buffer->data, buffer->length);
+
+    if(arena){
+
+        if(arena->data != arena->initial){
+            zlog_free(arena->data);
+        }else {
+            zlog_arena_register();
+        }
+
+        arena->data = data;
+        arena->capacity = capacity;
+
+    }else if(!buffer->arena && buffer->data != buffer->stack){
+        zlog_free(buffer->data);
+    }
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+    buffer->arena = arena;
+
+    return 0;
+
+}
+
+/*!
+    Function that makes room for the rest of a bounded buffer, up to ZLOG_RECORD_MAX_SIZE bytes
+    @param buffer the buffer
+    @return the number of bytes that can be appended
+*/
+
+static size_t zlog_buffer_reserve_rest(LogBuffer* buffer){
+
+    if(!buffer->bounded || buffer->length >= ZLOG_RECORD_MAX_SIZE) return 0;
+
+    if(zlog_buffer_reserve(buffer, ZLOG_RECORD_MAX_SIZE - buffer->length) != 0) return 0;
+
+    return buffer->capacity - buffer->length;
+
+}
+
+static void zlog_buffer_append(LogBuffer* buffer, const char* bytes, size_t size){
+
+    if(zlog_buffer_reserve(buffer, size) != 0){
+        size_t rest = zlog_buffer_reserve_rest(buffer);
+        if(rest < size) size = rest;
+    }
+
+    memcpy(buffer->data + buffer->length, bytes, size);
+    buffer->length += size;
+
+}
+
+static void zlog_buffer_puts(LogBuffer* buffer, const char* str){
+    zlog_buffer_append(buffer, str, strlen(str));
+}
+
+static void zlog_buffer_vprintf(LogBuffer* buffer, const char* fmt, va_list args){
+
+    va_list copy;
+    va_copy(copy, args);
+    int size = vsnprintf(buffer->data + buffer->length, buffer->capacity - buffer->length, fmt, copy);
+    va_end(copy);
+
+    if(size < 0) return;
+
+    if((size_t)size >= buffer->capacity - buffer->length){
+
+        if(zlog_buffer_reserve(buffer, (size_t)size + 1) != 0){
+
+            size_t rest = zlog_buffer_reserve_rest(buffer);
+            if(rest < 4) return;
+
+            vsnprintf(buffer->data + buffer->length, rest, fmt, args);
+            memcpy(buffer->data + buffer->length + rest - 4, "...\n", 4);
+            buffer->length += rest;
+
+            return;
+
+        }
+
+        vsnprintf(buffer->data + buffer->length, buffer->capacity - buffer->length, fmt, args);
+
+    }
+
+    buffer->length += (size_t)size;
+
+}
+
+static void zlog_buffer_printf(LogBuffer* buffer, const char* fmt, ...){
+
+    va_list args;
+    va_start(args, fmt);
+    zlog_buffer_vprintf(buffer, fmt, args);
+    va_end(args);
+
+}
+
+static void zlog_buffer_append_u64(LogBuffer* buffer, uint64_t value){
+
+    char digits[20];
+    zlog_buffer_append(buffer, digits, zlog_format_u64(digits, value));
+
+}
+
+/*!
+    Function that appends the location of a callsite, file:line
+    @param buffer the buffer
+    @param filename the file of the callsite
+    @param line the line of the callsite
+*/
+
+static void zlog_buffer_append_location(LogBuffer* buffer, const char* filename, uint64_t line){
+
+    zlog_buffer_puts(buffer, filename);
+    zlog_buffer_append(buffer, ":", 1);
+    zlog_buffer_append_u64(buffer, line);
+
+}
+
+/*!
+    Function that appends the tag of a level between square brackets
+    @param buffer the buffer
+    @param level the level
+*/
+
+static void zlog_buffer_append_tag(LogBuffer* buffer, LogLevel level){
+
+    zlog_buffer_append(buffer, "[", 1);
+    zlog_buffer_puts(buffer, log_tag[level]);
+    zlog_buffer_append(buffer, "]", 1);
+
+}
+
+/*!
+    Function that appends a field rendered for every record: the date and time fields, 
+    with the sub-second digits appended to the fields cached for the second, the thread and the cpu
+    @param buffer the buffer
+    @param type the field, from DAY to CPU
+    @param time_fields the fields of the second of the record
+    @param nanoseconds the nanoseconds of the record
+*/
+
+static void zlog_buffer_append_field(LogBuffer* buffer, PatternType type, const LogTimeCache* time_fields, long nanoseconds){
+
+    char digits[10];
+
+    switch(type){
+        case MILLISECOND:
+            zlog_format_fixed(digits, (uint32_t)(nanoseconds / 1000000), 3);
+            zlog_buffer_append(buffer, digits, 3);
+            break;
+        case MICROSECOND:
+            zlog_format_fixed(digits, (uint32_t)(nanoseconds / 1000), 6);
+            zlog_buffer_append(buffer, digits, 6);
+            break;
+        case NANOSECOND:
+            zlog_format_fixed(digits, (uint32_t)nanoseconds, 9);
+            zlog_buffer_append(buffer, digits, 9);
+            break;
+        #ifdef ZLOG_DECODER
+        case THREAD:
+        case CPU:
+            zlog_buffer_append(buffer, "-", 1);
+            break;
+        #else
+        case THREAD: {
+            const LogThreadId *id = zlog_current_thread_id();
+            zlog_buffer_append(buffer, id->text, id->length);
+            break;
+        }
+        case CPU: {
+            int cpu = zlog_current_cpu();
+            if(cpu < 0) zlog_buffer_append(buffer, "-", 1);
+            else zlog_buffer_append(buffer, digits, zlog_format_u32(digits, (uint32_t)cpu));
+            break;
+        }
+        #endif
+        default:
+            zlog_buffer_append(buffer, time_fields->fields[type], time_fields->lengths[type]);
+            break;
+    }
+
+}
+
+/*!
+    File of a file sink. The write path only compares the size with max_bytes and the time with the next rotation, 
+    the file is renamed and opened again once per rotation by the thread that writes it (the background thread in asynchronous mode)
+
+    @param lock the mutex taken to write the file
+    @param path the path of the file
+    @param stream the open file, NULL once the sink has been removed
+    @param bytes the size of the file
+    @param rotation when the file is rotated
+    @param next_rotation the time of the next rotation, 0 if the file isn't rotated by time
+    @param rotations the number of rotations of the file
+*/
+typedef struct LogFile {
+
+    LogMutex lock;
+    char * path;
+    FILE * stream;
+    uint64_t bytes;
+    LogRotation rotation;
+    time_t next_rotation;
+    uint64_t rotations;
+
+}LogFile;
+
+static void zlog_compress_schedule(LogFile* file);
+
+static void zlog_segment_path(char* buffer, size_t size, const LogFile* file, uint64_t index, const char* extension){
+
+    snprintf(buffer, size, "%s.%llu%s", file->path, (unsigned long long)index, extension);
+
+}
+
+/*!
+    Function that returns the time of the next rotation of a file sink, at the start of the next hour or day
+    @param now the current time
+    @param interval the interval of the rotation
+    @return the time of the next rotation, 0 if the file isn't rotated by time
+*/
+
+static time_t zlog_file_next_rotation(time_t now, LogRotateInterval interval){
+
+    if(interval == ZLOG_ROTATE_NEVER) return 0;
+
+    struct tm tm;
+
+    #if defined _WIN32
+        localtime_s(&tm, &now);
+    #else
+        localtime_r(&now, &tm);
+    #endif
+
+    tm.tm_sec = 0;
+    tm.tm_min = 0;
+
+    if(interval == ZLOG_ROTATE_DAILY){
+        tm.tm_hour = 0;
+        tm.tm_mday++;
+    }else {
+        tm.tm_hour++;
+    }
+
+    tm.tm_isdst = -1;
+
+    time_t next = mktime(&tm);
+
+    return next > now ? next : now + 1;
+
+}
+
+/*!
+    Function that rotates a file sink: path.N-1 is renamed to path.N and so on, path to path.1, 
+    the retained files beyond max_files are removed and path is opened again.
+    With a codec, path.1 is queued for the compression thread and the compressed segments are shifted too
+    @param file the file, its lock is held
+*/
+
+static void zlog_file_rotate(LogFile* file){
+
+    fclose(file->stream);
+    file->stream = NULL;
+
+    const char *extension = file->rotation.codec ? file->rotation.codec->extension : "";
+    size_t length = strlen(file->path) + strlen(extension) + 32;
+    char *from = (char*)zlog_malloc(length);
+    char *to = (char*)zlog_malloc(length);
+
+    if(from && to){
+
+        for(unsigned i = file->rotation.max_files; i > 0; i--){
+
+            for(int compressed = 0; compressed <= (extension[0] ? 1 : 0); compressed++){
+
+                const char *suffix = compressed ? extension : "";
+
+                zlog_segment_path(to, length, file, i, suffix);
+                remove(to);
+
+                if(i > 1){
+                    zlog_segment_path(from, length, file, i - 1, suffix);
+                    rename(from, to);
+                }else if(!compressed){
+                    rename(file->path, to);
+                }
+
+            }
+
+        }
+
+    }
+
+    zlog_free(from);
+    zlog_free(to);
+
+    file->stream = fopen(file->path, "w");
+    file->bytes = 0;
+    file->rotations++;
+
+    if(!file->stream){
+        fprintf(stderr, "[ERROR] Couldn't open file: %s\n", file->path);
+    }
+
+    if(file->rotation.codec && file->rotation.max_files > 0){
+        zlog_compress_schedule(file);
+    }
+
+}
+
+/*!
+    Function that opens the file of a file sink
+    @param path the path of the file
+    @param mode the mode in which the file is opened
+    @param rotation when the file is rotated, NULL if it is never rotated
+    @return the file or NULL if it couldn't be opened
+*/
+
+static LogFile* zlog_file_open(const char* path, const char* mode, const LogRotation* rotation){
+
+    LogFile *file = (LogFile*)zlog_malloc(sizeof(LogFile));
+    char *copy = (char*)zlog_malloc(strlen(path) + 1);
+    FILE *stream = file && copy ? fopen(path, mode) : NULL;
+
+    if(!stream){
+        fprintf(stderr, "[ERROR] Couldn't open file: %s\n", path);
+        zlog_free(file);
+        zlog_free(copy);
+        return NULL;
+    }
+
+    strcpy(copy, path);
+    zlog_mutex_init(&file->lock);
+
+    file->path = copy;
+    file->stream = stream;
+    file->rotation = rotation ? *rotation : (LogRotation){ 0, ZLOG_ROTATE_NEVER, 0, NULL };
+    file->rotations = 0;
+    file->next_rotation = zlog_file_next_rotation(zlog_clock_seconds(), file->rotation.interval);
+
+    fseek(stream, 0, SEEK_END);
+    long size = ftell(stream);
+    file->bytes = size > 0 ? (uint64_t)size : 0;
+
+    return file;
+
+}
+
+/*!
+    Function that writes to a file sink, the file is rotated before the write if the write would 
+    make it bigger than max_bytes or if the time of the rotation has come
+    @param file the file
+    @param data the data to write
+    @param length the length of the data
+*/
+
+static void zlog_file_write(LogFile* file, const char* data, size_t length){
+
+    zlog_mutex_lock(&file->lock);
+
+    if(file->stream){
+
+        int by_size = file->bytes > 0 && file->rotation.max_bytes > 0 && file->bytes + length > file->rotation.max_bytes;
+        int by_time = file->next_rotation != 0 && zlog_clock_seconds() >= file->next_rotation;
+
+        if(by_size || by_time) zlog_file_rotate(file);
+        if(by_time) file->next_rotation = zlog_file_next_rotation(zlog_clock_seconds(), file->rotation.interval);
+
+    }
+
+    if(file->stream){
+        fwrite(data, 1, length, file->stream);
+        file->bytes += length;
+    }
+
+    zlog_mutex_unlock(&file->lock);
+
+}
+
+static void zlog_file_flush(LogFile* file){
+
+    zlog_mutex_lock(&file->lock);
+    if(file->stream) fflush(file->stream);
+    zlog_mutex_unlock(&file->lock);
+
+}
+
+/*!
+    Function that closes the file of a file sink and frees it, once no log call, record of the asynchronous mode 
+    or compression of a rotated file uses it
+    @param file the file
+*/
+
+static void zlog_file_free(LogFile* file){
+
+    if(file->stream) fclose(file->stream);
+
+    zlog_mutex_destroy(&file->lock);
+    zlog_free(file->path);
+    zlog_free(file);
+
+}
+
+/*!
+    Function that writes a record to a sink
+    @param sink the sink
+    @param data the record
+    @param length the length of the record
+*/
+
+static void zlog_sink_write(const LogSink* sink, const char* data, size_t length){
+
+    if(sink->file){
+        zlog_file_write(sink->file, data, length);
+    }else {
+        fwrite(data, 1, length, sink->stream);
+    }
+
+}
+
+static void zlog_sink_flush(const LogSink* sink){
+
+    if(sink->file){
+        zlog_file_flush(sink->file);
+    }else {
+        fflush(sink->stream);
+    }
+
+}
+
+/*
+    Threads used by the asynchronous mode and by the compression of the rotated files
+*/
+
+#if defined _WIN32
+    typedef HANDLE LogThread;
+    #define ZLOG_THREAD_FN(name) DWORD WINAPI name(LPVOID arg)
+    #define ZLOG_THREAD_RETURN return 0
+    #define zlog_thread_create(thread, fn, arg) ((*(thread) = CreateThread(NULL, 0, fn, arg, 0, NULL)) ? 0 : -1)
+    #define zlog_thread_join(thread) (WaitForSingleObject(thread, INFINITE), CloseHandle(thread))
+    #define zlog_thread_yield() SwitchToThread()
+    #define zlog_sleep_us(us) Sleep((DWORD)((us) / 1000 ? (us) / 1000 : 1))
+    #define zlog_thread_lower_priority() SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST)
+#else
+    typedef pthread_t LogThread;
+    #define ZLOG_THREAD_FN(name) void* name(void* arg)
+    #define ZLOG_THREAD_RETURN return NULL
+    #define zlog_thread_create(thread, fn, arg) (pthread_create(thread, NULL, fn, arg) == 0 ? 0 : -1)
+    #define zlog_thread_join(thread) pthread_join(thread, NULL)
+    #define zlog_thread_yield() sched_yield()
+    #define zlog_sleep_us(us) nanosleep(&(struct timespec){ (us) / 1000000, ((us) % 1000000) * 1000 }, NULL)
+    #include <sched.h>
+    #if defined __linux__
+        #if defined SCHED_IDLE
+            #define ZLOG_SCHED_IDLE SCHED_IDLE
+        #else
+            #define ZLOG_SCHED_IDLE 5
+        #endif
+        #define zlog_thread_lower_priority() pthread_setschedparam(pthread_self(), ZLOG_SCHED_IDLE, &(struct sched_param){ 0 })
+    #else
+        #define zlog_thread_lower_priority() ((void)0)
+    #endif
+#endif
+
+/*
+    Max size of a record pushed in a ring of the asynchronous mode, 
+    bigger records are written directly by the thread that logs them
+*/
+
+#ifndef ZLOG_ASYNC_SLOT_SIZE
+#define ZLOG_ASYNC_SLOT_SIZE 512
+#endif
+
+/*
+    Microseconds the background thread sleeps when the rings are empty
+*/
+
+#ifndef ZLOG_ASYNC_IDLE_US
+#define ZLOG_ASYNC_IDLE_US 500
+#endif
+
+/*
+    Size of each of the two halves of the spill buffer used by the ZLOG_OVERFLOW_SPILL policy
+*/
+
+#ifndef ZLOG_ASYNC_SPILL_SIZE
+#define ZLOG_ASYNC_SPILL_SIZE (256 * 1024)
+#endif
+
+/*!
+    Slot of the ring of a thread in the asynchronous mode
+
+    @param sequence the turn of the slot: equal to the position when free, to the position + 1 when it holds a record
+    @param time the timestamp of the record in nanoseconds, used by the background thread to merge the rings
+    @param logger the logger that has pushed the record, its dropped counter is increased if the record is overwritten
+    @param stream the stream where the record is written
+    @param file the file where the record is written, for the file sinks
+    @param length the length of the record
+    @param pinned whether the record is a summary of the dropped records, which is never overwritten
+    @param data the rendered record
+*/
+typedef struct {
+
+    atomic_size_t sequence;
+    _Atomic(int64_t) time;
+    zlogger * logger;
+    FILE * stream;
+    LogFile * file;
+    size_t length;
+    int pinned;
+    char data[ZLOG_ASYNC_SLOT_SIZE];
+
+}LogSlot;
+
+/*!
+    Bounded ring of the records pushed by a thread, registered by the first record the thread pushes.
+    The thread is the only producer and the background thread the consumer, the producer also takes 
+    the oldest records with the ZLOG_OVERFLOW_OVERWRITE policy, so the read position is claimed with a compare and swap.
+    The positions are padded to their own cache line: the producers never share a written cache line
+
+    @param enqueue_pos the next position written by the thread
+    @param dequeue_pos the next position read by the background thread
+    @param closed whether the thread has exited, the ring is freed by the background thread once it is empty
+    @param mask the capacity of the ring - 1
+    @param next the next ring of the registry
+    @param slots the ring of slots
+*/
+typedef struct LogRing {
+
+    atomic_size_t enqueue_pos;
+    char padding_enqueue[64 - sizeof(atomic_size_t)];
+    atomic_size_t dequeue_pos;
+    char padding_dequeue[64 - sizeof(atomic_size_t)];
+    atomic_int closed;
+    size_t mask;
+    struct LogRing * next;
+    LogSlot slots[];
+
+}LogRing;
+
+/*!
+    Read position of the background thread in a ring during a drain
+
+    @param ring the ring
+    @param pos the position of the oldest record not written yet
+    @param end the position after the last record found when the drain started
+    @param time the timestamp of the record at pos
+*/
+typedef struct {
+
+    LogRing * ring;
+    size_t pos;
+    size_t end;
+    int64_t time;
+
+}LogRingCursor;
+
+/*!
+    State of the asynchronous mode: the registry of the rings of the threads and the background thread that drains them
+
+    @param rings the registry of the rings, the new rings are added at the head
+    @param capacity the number of records a ring can hold
+    @param cursors the positions in the rings used by the background thread, one per ring with records
+    @param cursor_capacity the number of cursors allocated
+    @param reclaimed the records pushed to the rings that have been freed
+    @param closed the number of rings of exited threads not freed yet
+    @param written the number of records written to their streams by the background thread, or overwritten
+    @param running whether the log calls push the records in the rings
+    @param thread the background thread
+*/
+typedef struct {
+
+    _Atomic(LogRing *) rings;
+    size_t capacity;
+    LogRingCursor * cursors;
+    size_t cursor_capacity;
+    size_t reclaimed;
+    atomic_size_t closed;
+    _Alignas(64) atomic_size_t written;
+    atomic_int running;
+    LogThread thread;
+
+}LogAsyncQueue;
+
+static LogAsyncQueue zlog_async;
+
+/*
+    Lock taken to add a ring to the registry and to free the rings of the exited threads
+*/
+
+static LogMutex zlog_rings_lock = ZLOG_MUTEX_INIT;
+
+/*
+    Ring of the thread, NULL until the thread pushes its first record
+*/
+
+static ZLOG_THREAD_LOCAL LogRing * zlog_thread_ring;
+
+/*!
+    Function called when a thread with a ring exits, the ring is freed by the background thread once it is empty
+    @param ring the ring of the thread
+*/
+
+static void zlog_ring_close(LogRing* ring){
+
+    atomic_store_explicit(&ring->closed, 1, memory_order_release);
+    atomic_fetch_add_explicit(&zlog_async.closed, 1, memory_order_release);
+
+}
+
+#if defined _WIN32
+
+static DWORD zlog_ring_key = FLS_OUT_OF_INDEXES;
+
+static VOID WINAPI zlog_ring_exit(PVOID ring){
+    if(ring) zlog_ring_close((LogRing*)ring);
+}
+
+#else
+
+static pthread_key_t zlog_ring_key;
+static int zlog_ring_key_created;
+
+static void zlog_ring_exit(void* ring){
+    zlog_ring_close((LogRing*)ring);
+}
+
+#endif
+
+/*!
+    Function that returns the ring of the thread, allocated and added to the registry by the first call of the thread
+    @return the ring or NULL if it couldn't be allocated
+*/
+
+static LogRing* zlog_async_ring(){
+
+    LogRing *ring = zlog_thread_ring;
+
+    if(ring) return ring;
+
+    size_t capacity = zlog_async.capacity;
+
+    ring = (LogRing*)zlog_malloc(sizeof(LogRing) + capacity * sizeof(LogSlot));
+    if(!ring) return NULL;
+
+    for(size_t i = 0; i < capacity; i++){
+        atomic_init(&ring->slots[i].sequence, i);
+    }
+
+    atomic_init(&ring->enqueue_pos, 0);
+    atomic_init(&ring->dequeue_pos, 0);
+    atomic_init(&ring->closed, 0);
+    ring->mask = capacity - 1;
+
+    zlog_mutex_lock(&zlog_rings_lock);
+
+    #if defined _WIN32
+        if(zlog_ring_key == FLS_OUT_OF_INDEXES) zlog_ring_key = FlsAlloc(zlog_ring_exit);
+        if(zlog_ring_key != FLS_OUT_OF_INDEXES) FlsSetValue(zlog_ring_key, ring);
+    #else
+        if(!zlog_ring_key_created) zlog_ring_key_created = pthread_key_create(&zlog_ring_key, zlog_ring_exit) == 0;
+        if(zlog_ring_key_created) pthread_setspecific(zlog_ring_key, ring);
+    #endif
+
+    ring->next = atomic_load_explicit(&zlog_async.rings, memory_order_relaxed);
+    atomic_store_explicit(&zlog_async.rings, ring, memory_order_release);
+
+    zlog_mutex_unlock(&zlog_rings_lock);
+
+    zlog_thread_ring = ring;
+
+    return ring;
+
+}
+
+/*!
+    Function that frees the rings of the exited threads once the background thread has written their records
+*/
+
+static void zlog_async_reclaim(){
+
+    if(atomic_load_explicit(&zlog_async.closed, memory_order_acquire) == 0) return;
+
+    zlog_mutex_lock(&zlog_rings_lock);
+
+    LogRing *previous = NULL;
+    LogRing *ring = atomic_load_explicit(&zlog_async.rings, memory_order_relaxed);
+
+    while(ring){
+
+        LogRing *next = ring->next;
+        size_t pushed = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+
+        if(atomic_load_explicit(&ring->closed, memory_order_acquire) && atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed) == pushed){
+
+            if(previous) previous->next = next;
+            else atomic_store_explicit(&zlog_async.rings, next, memory_order_release);
+
+            zlog_async.reclaimed += pushed;
+            atomic_fetch_sub_explicit(&zlog_async.closed, 1, memory_order_relaxed);
+            zlog_free(ring);
+
+        }else {
+            previous = ring;
+        }
+
+        ring = next;
+
+    }
+
+    zlog_mutex_unlock(&zlog_rings_lock);
+
+}
+
+/*!
+    Spill buffer of the ZLOG_OVERFLOW_SPILL policy: the producers append to the active half 
+    while the background thread writes the other one
+
+    @param buffers the two halves, allocated when a logger sets the policy
+    @param lengths the bytes used in each half, every record is a LogSpillHeader followed by its data
+    @param active the half where the records are appended
+    @param pending the records in the buffer not written yet
+*/
+typedef struct {
+
+    char * buffers[2];
+    size_t lengths[2];
+    int active;
+    atomic_size_t pending;
+
+}LogSpill;
+
+typedef struct {
+
+    FILE * stream;
+    LogFile * file;
+    size_t length;
+
+}LogSpillHeader;
+
+static LogSpill zlog_spill;
+static LogMutex zlog_spill_lock = ZLOG_MUTEX_INIT;
+
+/*
+    Set while a thread logs the summary of the dropped records, which always waits for a free slot
+*/
+
+static ZLOG_THREAD_LOCAL int zlog_reporting_drops;
+
+/*!
+    Function that pushes a record in the ring of the thread and updates the high water mark of the logger
+    @param ring the ring of the thread
+    @param logger the logger of the record
+    @param sink the sink where the record is written
+    @param data the rendered record
+    @param length the length of the record
+    @param time the timestamp of the record in nanoseconds
+    @return 0 on success, -1 if the ring is full
+*/
+
+static int zlog_async_push(LogRing* ring, zlogger* logger, const LogSink* sink, const char* data, size_t length, int64_t time){
+
+    size_t pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    LogSlot *slot = &ring->slots[pos & ring->mask];
+
+    if(atomic_load_explicit(&slot->sequence, memory_order_acquire) != pos) return -1;
+
+    atomic_store_explicit(&slot->time, time, memory_order_relaxed);
+    slot->logger = logger;
+    slot->stream = sink->stream;
+    slot->file = sink->file;
+    slot->length = length;
+    slot->pinned = zlog_reporting_drops;
+    memcpy(slot->data, data, length);
+
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    atomic_store_explicit(&ring->enqueue_pos, pos + 1, memory_order_relaxed);
+
+    intptr_t depth = (intptr_t)(pos + 1 - atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed));
+    uint64_t mark = atomic_load_explicit(&logger->high_water, memory_order_relaxed);
+
+    while(depth > 0 && (uint64_t)depth > mark && 
+          !atomic_compare_exchange_weak_explicit(&logger->high_water, &mark, (uint64_t)depth, memory_order_relaxed, memory_order_relaxed));
+
+    return 0;
+
+}
+
+/*!
+    Function that takes the record at the read position of a ring, the background thread 
+    and the thread of the ring (with the ZLOG_OVERFLOW_OVERWRITE policy) race for it.
+    The slot must be released with zlog_async_release() once the record has been consumed
+    @param ring the ring
+    @param pos the read position, set to the current one if the record has been taken by the other side
+    @return 1 if the record has been taken, 0 otherwise
+*/
+
+static int zlog_async_take(LogRing* ring, size_t* pos){
+
+    return atomic_compare_exchange_strong_explicit(&ring->dequeue_pos, pos, *pos + 1, memory_order_relaxed, memory_order_relaxed);
+
+}
+
+static void zlog_async_release(LogRing* ring, LogSlot* slot, size_t pos){
+    atomic_store_explicit(&slot->sequence, pos + ring->mask + 1, memory_order_release);
+}
+
+/*!
+    Function that writes the batch of records collected by the background thread
+    @param batch the records collected for the same sink
+    @param sink the sink of the records
+*/
+
+static void zlog_async_write_batch(LogBuffer* batch, const LogSink* sink){
+
+    if(batch->length == 0) return;
+
+    zlog_sink_write(sink, batch->data, batch->length);
+    batch->length = 0;
+
+}
+
+/*!
+    Function that adds a record to the batch, the batch is written first if the record goes to another sink or doesn't fit
+    @param batch the records collected for the same sink
+    @param batch_sink the sink of the batch
+    @param stream the stream of the record
+    @param file the file of the record
+    @param data the record
+    @param length the length of the record
+*/
+
+static void zlog_async_batch(LogBuffer* batch, LogSink* batch_sink, FILE* stream, LogFile* file, const char* data, size_t length){
+
+    if(stream != batch_sink->stream || file != batch_sink->file || batch->length + length > batch->capacity){
+        zlog_async_write_batch(batch, batch_sink);
+        batch_sink->stream = stream;
+        batch_sink->file = file;
+    }
+
+    zlog_buffer_append(batch, data, length);
+
+}
+
+/*!
+    Function that adds a cursor for a ring with records, the cursors are kept by the background thread between the drains
+    @param ring the ring
+    @param pos the read position of the ring
+    @param end the position after its last record
+    @param active the number of cursors in use
+    @return 0 on success, -1 if the cursors couldn't be allocated
+*/
+
+static int zlog_async_add_cursor(LogRing* ring, size_t pos, size_t end, size_t active){
+
+    if(active == zlog_async.cursor_capacity){
+
+        size_t capacity = zlog_async.cursor_capacity ? zlog_async.cursor_capacity * 2 : 16;
+        LogRingCursor *cursors = (LogRingCursor*)zlog_realloc(zlog_async.cursors, capacity * sizeof(LogRingCursor));
+
+        if(!cursors) return -1;
+
+        zlog_async.cursors = cursors;
+        zlog_async.cursor_capacity = capacity;
+
+    }
+
+    zlog_async.cursors[active] = (LogRingCursor){ ring, pos, end, atomic_load_explicit(&ring->slots[pos & ring->mask].time, memory_order_relaxed) };
+
+    return 0;
+
+}
+
+/*!
+    Function that pops the records found in the rings of the threads and writes them merged in timestamp order, 
+    consecutive records for the same stream are written with a single write.
+    The records pushed while the rings are merged are written by the next drain
+    @param batch the buffer used to collect the records
+    @return the number of records written
+*/
+
+static size_t zlog_async_drain(LogBuffer* batch){
+
+    zlog_async_reclaim();
+
+    size_t active = 0;
+
+    for(LogRing *ring = atomic_load_explicit(&zlog_async.rings, memory_order_acquire); ring; ring = ring->next){
+
+        size_t pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+        size_t end = pos;
+
+        while(end - pos <= ring->mask && atomic_load_explicit(&ring->slots[end & ring->mask].sequence, memory_order_acquire) == end + 1){
+            end++;
+        }
+
+        if(end == pos) continue;
+        if(zlog_async_add_cursor(ring, pos, end, active) != 0) break;
+
+        active++;
+
+    }
+
+    LogRingCursor *cursors = zlog_async.cursors;
+    LogSink batch_sink = { NULL, L_TRACE, 0, 0, NULL };
+    size_t count = 0;
+
+    while(active > 0){
+
+        size_t oldest = 0;
+
+        for(size_t i = 1; i < active; i++){
+            if(cursors[i].time < cursors[oldest].time) oldest = i;
+        }
+
+        LogRingCursor *cursor = &cursors[oldest];
+        LogRing *ring = cursor->ring;
+        size_t pos = cursor->pos;
+
+        if(zlog_async_take(ring, &pos)){
+
+            LogSlot *slot = &ring->slots[pos & ring->mask];
+
+            zlog_async_batch(batch, &batch_sink, slot->stream, slot->file, slot->data, slot->length);
+            zlog_async_release(ring, slot, pos);
+
+            pos++;
+            count++;
+
+        }
+
+        if(pos >= cursor->end){
+            *cursor = cursors[--active];
+        }else {
+            cursor->pos = pos;
+            cursor->time = atomic_load_explicit(&ring->slots[pos & ring->mask].time, memory_order_relaxed);
+        }
+
+    }
+
+    zlog_async_write_batch(batch, &batch_sink);
+
+    if(count) atomic_fetch_add_explicit(&zlog_async.written, count, memory_order_release);
+
+    return count;
+
+}
+
+/*!
+    Function that swaps the halves of the spill buffer and writes the records of the full one
+    @param batch the buffer used to collect the records
+    @return the number of records written
+*/
+
+static size_t zlog_async_drain_spill(LogBuffer* batch){
+
+    zlog_mutex_lock(&zlog_spill_lock);
+
+    int half = zlog_spill.active;
+    size_t length = zlog_spill.lengths[half];
+    if(length) zlog_spill.active = !half;
+
+    zlog_mutex_unlock(&zlog_spill_lock);
+
+    if(length == 0) return 0;
+
+    LogSink batch_sink = { NULL, L_TRACE, 0, 0, NULL };
+    const char *cursor = zlog_spill.buffers[half];
+    const char *end = cursor + length;
+    size_t count = 0;
+
+    while(cursor < end){
+
+        LogSpillHeader header;
+        memcpy(&header, cursor, sizeof(header));
+        cursor += sizeof(header);
+
+        zlog_async_batch(batch, &batch_sink, header.stream, header.file, cursor, header.length);
+        cursor += header.length;
+
+        count++;
+
+    }
+
+    zlog_async_write_batch(batch, &batch_sink);
+
+    zlog_mutex_lock(&zlog_spill_lock);
+    zlog_spill.lengths[half] = 0;
+    zlog_mutex_unlock(&zlog_spill_lock);
+
+    atomic_fetch_sub_explicit(&zlog_spill.pending, count, memory_order_release);
+
+    return count;
+
+}
+
+/*!
+    Function that appends a record to the active half of the spill buffer
+    @param sink the sink where the record is written
+    @param data the rendered record
+    @param length the length of the record
+    @return 0 on success, -1 if the buffer is full or has not been allocated
+*/
+
+static int zlog_async_spill(const LogSink* sink, const char* data, size_t length){
+
+    LogSpillHeader header = { sink->stream, sink->file, length };
+    int result = -1;
+
+    zlog_mutex_lock(&zlog_spill_lock);
+
+    int half = zlog_spill.active;
+    size_t used = zlog_spill.lengths[half];
+
+    if(zlog_spill.buffers[half] && used + sizeof(header) + length <= ZLOG_ASYNC_SPILL_SIZE){
+        memcpy(zlog_spill.buffers[half] + used, &header, sizeof(header));
+        memcpy(zlog_spill.buffers[half] + used + sizeof(header), data, length);
+        zlog_spill.lengths[half] = used + sizeof(header) + length;
+        atomic_fetch_add_explicit(&zlog_spill.pending, 1, memory_order_relaxed);
+        result = 0;
+    }
+
+    zlog_mutex_unlock(&zlog_spill_lock);
+
+    return result;
+
+}
+
+/*!
+    Function that drops the oldest record of the ring of the thread, counted on the logger that has pushed it.
+    A summary of the dropped records is not dropped: the thread waits for the background thread to write it
+    @param ring the ring of the thread
+    @return 1 if a record has been dropped, 0 if the ring is empty, the oldest record is a summary 
+            or the background thread is taking the record
+*/
+
+static int zlog_async_overwrite(LogRing* ring){
+
+    size_t pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+    LogSlot *slot = &ring->slots[pos & ring->mask];
+
+    if(atomic_load_explicit(&slot->sequence, memory_order_acquire) != pos + 1 || slot->pinned || !zlog_async_take(ring, &pos)) return 0;
+
+    zlogger *logger = slot->logger;
+    zlog_async_release(ring, slot, pos);
+
+    atomic_fetch_add_explicit(&logger->dropped, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&zlog_async.written, 1, memory_order_release);
+
+    return 1;
+
+}
+
+/*!
+    Function that pushes a record in the ring of the thread, applying the overflow policy of the logger when the ring is full.
+    The record is written directly if the ring couldn't be allocated
+    @param logger the logger of the record
+    @param sink the sink where the record is written
+    @param data the rendered record
+    @param length the length of the record
+    @param time the timestamp of the record
+*/
+
+static void zlog_async_submit(zlogger* logger, const LogSink* sink, const char* data, size_t length, const struct timespec* time){
+
+    LogRing *ring = zlog_async_ring();
+
+    if(!ring){
+        zlog_sink_write(sink, data, length);
+        return;
+    }
+
+    int64_t timestamp = (int64_t)time->tv_sec * 1000000000 + time->tv_nsec;
+
+    if(zlog_async_push(ring, logger, sink, data, length, timestamp) == 0) return;
+
+    LogOverflowPolicy policy = zlog_reporting_drops ? ZLOG_OVERFLOW_BLOCK : atomic_load_explicit(&logger->overflow, memory_order_relaxed);
+
+    switch(policy){
+
+        case ZLOG_OVERFLOW_DROP:
+            atomic_fetch_add_explicit(&logger->dropped, 1, memory_order_relaxed);
+            break;
+
+        case ZLOG_OVERFLOW_OVERWRITE:
+            do {
+                if(!zlog_async_overwrite(ring)) zlog_thread_yield();
+            } while(zlog_async_push(ring, logger, sink, data, length, timestamp) != 0);
+            break;
+
+        case ZLOG_OVERFLOW_SPILL:
+            if(zlog_async_spill(sink, data, length) == 0){
+                atomic_fetch_add_explicit(&logger->spilled, 1, memory_order_relaxed);
+            }else {
+                atomic_fetch_add_explicit(&logger->dropped, 1, memory_order_relaxed);
+            }
+            break;
+
+        default: {
+
+            uint64_t start = zlog_monotonic_ns();
+
+            while(zlog_async_push(ring, logger, sink, data, length, timestamp) != 0){
+                zlog_thread_yield();
+            }
+
+            atomic_fetch_add_explicit(&logger->blocked_ns, zlog_monotonic_ns() - start, memory_order_relaxed);
+            break;
+
+        }
+
+    }
+
+}
+
+static ZLOG_THREAD_FN(zlog_async_thread){
+
+    (void)arg;
+
+    LogBuffer batch;
+    zlog_buffer_init(&batch);
+    zlog_buffer_reserve(&batch, (size_t)ZLOG_ASYNC_SLOT_SIZE * 64);
+
+    while(atomic_load_explicit(&zlog_async.running, memory_order_acquire)){
+        if(zlog_async_drain(&batch) + zlog_async_drain_spill(&batch) == 0){
+            zlog_sleep_us(ZLOG_ASYNC_IDLE_US);
+        }
+    }
+
+    zlog_async_drain(&batch);
+    zlog_async_drain_spill(&batch);
+    zlog_buffer_free(&batch);
+
+    ZLOG_THREAD_RETURN;
+
+}
+
+/*!
+    Function that waits until every record pushed before the call has been written, the spill buffer included
+*/
+
+static void zlog_async_wait(){
+
+    if(!atomic_load_explicit(&zlog_async.running, memory_order_acquire)) return;
+
+    zlog_mutex_lock(&zlog_rings_lock);
+
+    size_t target = zlog_async.reclaimed;
+
+    for(LogRing *ring = atomic_load_explicit(&zlog_async.rings, memory_order_relaxed); ring; ring = ring->next){
+        target += atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    }
+
+    zlog_mutex_unlock(&zlog_rings_lock);
+
+    while(atomic_load_explicit(&zlog_async.running, memory_order_acquire) &&
+          (atomic_load_explicit(&zlog_async.written, memory_order_acquire) < target ||
+           atomic_load_explicit(&zlog_spill.pending, memory_order_acquire) > 0)){
+        zlog_thread_yield();
+    }
+
+}
+
+int zlog_async_init(size_t capacity){
+
+    if(atomic_load(&zlog_async.running)) return -1;
+
+    size_t size = 2;
+    while(size < capacity) size *= 2;
+
+    zlog_async.capacity = size;
+
+    return 0;
+
+}
+
+int zlog_async_start(){
+
+    static int registered = 0;
+
+    if(zlog_async.capacity == 0 || atomic_load(&zlog_async.running)) return -1;
+
+    atomic_store(&zlog_async.running, 1);
+
+    if(zlog_thread_create(&zlog_async.thread, zlog_async_thread, NULL) != 0){
+        atomic_store(&zlog_async.running, 0);
+        return -1;
+    }
+
+    if(!registered){
+        atexit(zlog_async_stop);
+        registered = 1;
+    }
+
+    return 0;
+
+}
+
+void zlog_async_stop(){
+
+    if(!atomic_exchange(&zlog_async.running, 0)) return;
+
+    zlog_thread_join(zlog_async.thread);
+
+    LogBuffer batch;
+    zlog_buffer_init(&batch);
+    zlog_async_drain(&batch);
+    zlog_async_drain_spill(&batch);
+    zlog_buffer_free(&batch);
+
+    zlog_free(zlog_async.cursors);
+    zlog_async.cursors = NULL;
+    zlog_async.cursor_capacity = 0;
+
+    zlog_flush();
+
+}
+
+void zlog_async_flush(){
+    zlog_flush();
+}
+
+int zlogger_set_overflow_policy(zlogger* logger, LogOverflowPolicy policy){
+
+    if(policy == ZLOG_OVERFLOW_SPILL){
+
+        zlog_mutex_lock(&zlog_spill_lock);
+
+        for(int i = 0; i < 2; i++){
+            if(!zlog_spill.buffers[i]) zlog_spill.buffers[i] = (char*)zlog_malloc(ZLOG_ASYNC_SPILL_SIZE);
+        }
+
+        int allocated = zlog_spill.buffers[0] && zlog_spill.buffers[1];
+
+        zlog_mutex_unlock(&zlog_spill_lock);
+
+        if(!allocated){
+            fprintf(stderr, "[ERROR] Couldn't allocate the spill buffer of %d bytes\n", 2 * ZLOG_ASYNC_SPILL_SIZE);
+            return -1;
+        }
+
+    }
+
+    atomic_store(&logger->overflow, policy);
+
+    return 0;
+
+}
+
+LogAsyncStats zlogger_get_async_stats(zlogger* logger){
+
+    LogAsyncStats stats;
+
+    stats.dropped = atomic_load(&logger->dropped);
+    stats.spilled = atomic_load(&logger->spilled);
+    stats.blocked_ns = atomic_load(&logger->blocked_ns);
+    stats.high_water = atomic_load(&logger->high_water);
+
+    return stats;
+
+}
+
+int zlogger_set_clock(zlogger* logger, LogClockSource clock){
+
+    if(clock == ZLOG_CLOCK_TSC && !ZLOG_HAS_TSC) return -1;
+
+    zlog_clock_now(clock);
+    atomic_store(&logger->clock, clock);
+
+    return 0;
+
+}
+
+static int zlog_set_clock(LogClockSource clock){
+    return zlogger_set_clock(&zlog, clock);
+}
+
+static int zlog_set_overflow_policy(LogOverflowPolicy policy){
+    return zlogger_set_overflow_policy(&zlog, policy);
+}
+
+static LogAsyncStats zlog_get_async_stats(){
+    return zlogger_get_async_stats(&zlog);
+}
+
+/*
+    Size of the blocks of the built-in codec
+*/
+
+#define ZLOG_LZ_BLOCK_SIZE (64 * 1024)
+#define ZLOG_LZ_HASH_BITS 12
+#define ZLOG_LZ_MIN_MATCH 4
+#define ZLOG_LZ_LAST_LITERALS 5
+#define ZLOG_LZ_MAGIC "ZLZ1"
+
+static uint32_t zlog_lz_read32(const uint8_t* p){
+
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+
+    return value;
+
+}
+
+static uint8_t* zlog_lz_put_length(uint8_t* op, size_t length){
+
+    while(length >= 255){
+        *op++ = 255;
+        length -= 255;
+    }
+
+    *op++ = (uint8_t)length;
+
+    return op;
+
+}
+
+/*!
+    Function that compresses a block with the built-in codec, an LZ4 like sequence of 
+    literal runs and matches (token, literal length, literals, 16 bit offset, match length)
+    @param src the block
+    @param size the size of the block, at most ZLOG_LZ_BLOCK_SIZE
+    @param dst the compressed block, at least size + size / 255 + 16 bytes
+    @return the size of the compressed block
+*/
+
+static size_t zlog_lz_compress_block(const uint8_t* src, size_t size, uint8_t* dst){
+
+    uint32_t table[1 << ZLOG_LZ_HASH_BITS] = { 0 };
+    uint8_t *op = dst;
+    size_t anchor = 0;
+    size_t i = 0;
+
+    while(size > ZLOG_LZ_MIN_MATCH + ZLOG_LZ_LAST_LITERALS && i + ZLOG_LZ_MIN_MATCH + ZLOG_LZ_LAST_LITERALS <= size){
+
+        uint32_t sequence = zlog_lz_read32(src + i);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - ZLOG_LZ_HASH_BITS);
+        size_t candidate = table[hash];
+
+        table[hash] = (uint32_t)i + 1;
+
+        if(candidate == 0 || i - (candidate - 1) > 65535 || zlog_lz_read32(src + candidate - 1) != sequence){
+            i++;
+            continue;
+        }
+
+        candidate--;
+
+        size_t match = ZLOG_LZ_MIN_MATCH;
+        while(i + match < size - ZLOG_LZ_LAST_LITERALS && src[candidate + match] == src[i + match]) match++;
+
+        size_t literals = i - anchor;
+        uint8_t *token = op++;
+
+        *token = (uint8_t)(((literals < 15 ? literals : 15) << 4) | (match - ZLOG_LZ_MIN_MATCH < 15 ? match - ZLOG_LZ_MIN_MATCH : 15));
+
+        if(literals >= 15) op = zlog_lz_put_length(op, literals - 15);
+        memcpy(op, src + anchor, literals);
+        op += literals;
+
+        uint16_t offset = (uint16_t)(i - candidate);
+        *op++ = (uint8_t)(offset & 0xff);
+        *op++ = (uint8_t)(offset >> 8);
+
+        if(match - ZLOG_LZ_MIN_MATCH >= 15) op = zlog_lz_put_length(op, match - ZLOG_LZ_MIN_MATCH - 15);
+
+        i += match;
+        anchor = i;
+
+    }
+
+    size_t literals = size - anchor;
+
+    *op++ = (uint8_t)((literals < 15 ? literals : 15) << 4);
+    if(literals >= 15) op = zlog_lz_put_length(op, literals - 15);
+    memcpy(op, src + anchor, literals);
+    op += literals;
+
+    return (size_t)(op - dst);
+
+}
+
+/*!
+    Function that compresses a file with the built-in codec: the magic "ZLZ1" followed by blocks of 
+    (uint32 size, uint32 compressed size, data), a block that doesn't shrink is stored as it is 
+    (compressed size equal to the size), a block of size 0 ends the file
+    @param source the file to compress
+    @param target the compressed file
+    @return 0 on success, -1 otherwise
+*/
+
+static int zlog_lz_compress(FILE* source, FILE* target){
+
+    uint8_t *block = (uint8_t*)zlog_malloc(ZLOG_LZ_BLOCK_SIZE);
+    uint8_t *compressed = (uint8_t*)zlog_malloc(ZLOG_LZ_BLOCK_SIZE + ZLOG_LZ_BLOCK_SIZE / 255 + 16);
+    int result = -1;
+
+    if(block && compressed && fwrite(ZLOG_LZ_MAGIC, 1, 4, target) == 4){
+
+        size_t size;
+
+        while((size = fread(block, 1, ZLOG_LZ_BLOCK_SIZE, source)) > 0){
+
+            size_t compressed_size = zlog_lz_compress_block(block, size, compressed);
+            const uint8_t *data = compressed;
+
+            if(compressed_size >= size){
+                compressed_size = size;
+                data = block;
+            }
+
+            uint32_t header[2] = { (uint32_t)size, (uint32_t)compressed_size };
+
+            if(fwrite(header, sizeof(header), 1, target) != 1 || fwrite(data, 1, compressed_size, target) != compressed_size) break;
+
+        }
+
+        uint32_t end[2] = { 0, 0 };
+
+        if(!ferror(source) && size == 0 && fwrite(end, sizeof(end), 1, target) == 1) result = 0;
+
+    }
+
+    zlog_free(block);
+    zlog_free(compressed);
+
+    return result;
+
+}
+
+const LogCodec zlog_codec_lz = { ".zlz", zlog_lz_compress };
+
+#ifdef ZLOG_DECODER
+
+static int zlog_lz_get_length(const uint8_t** ip, const uint8_t* end, size_t* length){
+
+    uint8_t byte;
+
+    do {
+        if(*ip >= end) return -1;
+        byte = *(*ip)++;
+        *length += byte;
+    } while(byte == 255);
+
+    return 0;
+
+}
+
+/*!
+    Function that decompresses a block of the built-in codec, every length and offset is checked
+    @param src the compressed block
+    @param size the size of the compressed block
+    @param dst the block
+    @param capacity the size of the block
+    @return 0 on success, -1 if the block is corrupted
+*/
+
+static int zlog_lz_decompress_block(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity){
+
+    const uint8_t *ip = src;
+    const uint8_t *end = src + size;
+    size_t op = 0;
+
+    while(ip < end){
+
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+
+        if(literals == 15 && zlog_lz_get_length(&ip, end, &literals) != 0) return -1;
+        if((size_t)(end - ip) < literals || capacity - op < literals) return -1;
+
+        memcpy(dst + op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        if(ip == end) break;
+
+        if(end - ip < 2) return -1;
+
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        size_t match = (size_t)(token & 15);
+        ip += 2;
+
+        if(match == 15 && zlog_lz_get_length(&ip, end, &match) != 0) return -1;
+        match += ZLOG_LZ_MIN_MATCH;
+
+        if(offset == 0 || offset > op || capacity - op < match) return -1;
+
+        for(size_t i = 0; i < match; i++, op++){
+            dst[op] = dst[op - offset];
+        }
+
+    }
+
+    return op == capacity ? 0 : -1;
+
+}
+
+/*!
+    Function that decompresses a file written by the built-in codec.
+    Compiled only by the tools that read the log files, which define ZLOG_DECODER
+    @param data the content of the file, starting with "ZLZ1"
+    @param size the size of the file
+    @param out_size the size of the decompressed file
+    @return the decompressed file allocated with malloc, NULL if the file is corrupted
+*/
+
+static char* zlog_lz_decompress(const char* data, size_t size, size_t* out_size){
+
+    const uint8_t *ip = (const uint8_t*)data + 4;
+    const uint8_t *end = (const uint8_t*)data + size;
+    size_t capacity = 1 << 16;
+    char *out = (char*)zlog_malloc(capacity);
+
+    *out_size = 0;
+
+    if(size < 4 || memcmp(data, ZLOG_LZ_MAGIC, 4) != 0) ip = end;
+
+    while(out && ip < end){
+
+        uint32_t header[2];
+
+        if(end - ip < (ptrdiff_t)sizeof(header)) break;
+
+        memcpy(header, ip, sizeof(header));
+        ip += sizeof(header);
+
+        if(header[0] == 0 && header[1] == 0) return out;
+
+        if(header[0] > ZLOG_LZ_BLOCK_SIZE || header[1] > header[0] || (size_t)(end - ip) < header[1]) break;
+
+        while(capacity - *out_size < header[0]){
+            capacity *= 2;
+            char *bigger = (char*)zlog_realloc(out, capacity);
+            if(!bigger) zlog_free(out);
+            out = bigger;
+            if(!out) return NULL;
+        }
+
+        uint8_t *block = (uint8_t*)out + *out_size;
+
+        if(header[1] == header[0]){
+            memcpy(block, ip, header[0]);
+        }else if(zlog_lz_decompress_block(ip, header[1], block, header[0]) != 0){
+            break;
+        }
+
+        ip += header[1];
+        *out_size += header[0];
+
+    }
+
+    zlog_free(out);
+
+    return NULL;
+
+}
+
+#endif /* ZLOG_DECODER */
+
+/*!
+    Job of the compression thread: the segment written by a rotation of a file sink
+
+    @param file the file sink
+    @param generation the number of rotations of the file when the segment has been rotated, 
+                      the segment is file.(rotations - generation + 1) until it is removed
+    @param next the next job
+*/
+typedef struct LogCompressJob {
+
+    LogFile * file;
+    uint64_t generation;
+    struct LogCompressJob * next;
+
+}LogCompressJob;
+
+/*!
+    State of the compression thread
+
+    @param jobs the first job of the queue
+    @param last the last job of the queue
+    @param pending the number of jobs not completed yet
+    @param running whether the thread is running
+    @param thread the compression thread
+*/
+typedef struct {
+
+    LogCompressJob * jobs;
+    LogCompressJob * last;
+    atomic_size_t pending;
+    atomic_int running;
+    LogThread thread;
+
+}LogCompressor;
+
+static LogCompressor zlog_compressor;
+static LogMutex zlog_compress_lock = ZLOG_MUTEX_INIT;
+
+/*
+    Microseconds the compression thread sleeps when there are no jobs
+*/
+
+#ifndef ZLOG_COMPRESS_IDLE_US
+#define ZLOG_COMPRESS_IDLE_US 100000
+#endif
+
+/*!
+    Function that compresses a rotated segment, the lock of the file is taken only to find the 
+    segment and to rename the compressed file, so the rotations can go on during the compression
+    @param job the job
+*/
+
+static void zlog_compress_segment(const LogCompressJob* job){
+
+    LogFile *file = job->file;
+    const LogCodec *codec = file->rotation.codec;
+
+    size_t length = strlen(file->path) + strlen(codec->extension) + 48;
+    char *segment = (char*)zlog_malloc(length);
+    char *target = (char*)zlog_malloc(length);
+    char *temporary = (char*)zlog_malloc(length);
+
+    if(!segment || !target || !temporary){
+        zlog_free(segment);
+        zlog_free(target);
+        zlog_free(temporary);
+        return;
+    }
+
+    snprintf(temporary, length, "%s.%llu.tmp", file->path, (unsigned long long)job->generation);
+
+    zlog_mutex_lock(&file->lock);
+
+    uint64_t index = file->rotations - job->generation + 1;
+    FILE *source = NULL;
+
+    if(index <= file->rotation.max_files){
+        zlog_segment_path(segment, length, file, index, "");
+        source = fopen(segment, "rb");
+    }
+
+    zlog_mutex_unlock(&file->lock);
+
+    if(source){
+
+        FILE *compressed = fopen(temporary, "wb");
+        int result = compressed ? codec->compress(source, compressed) : -1;
+
+        fclose(source);
+        if(compressed && fclose(compressed) != 0) result = -1;
+
+        zlog_mutex_lock(&file->lock);
+
+        index = file->rotations - job->generation + 1;
+
+        if(result == 0 && index <= file->rotation.max_files){
+            zlog_segment_path(segment, length, file, index, "");
+            zlog_segment_path(target, length, file, index, codec->extension);
+            remove(target);
+            if(rename(temporary, target) == 0) remove(segment);
+        }
+
+        zlog_mutex_unlock(&file->lock);
+
+        remove(temporary);
+
+    }
+
+    zlog_free(segment);
+    zlog_free(target);
+    zlog_free(temporary);
+
+}
+
+static ZLOG_THREAD_FN(zlog_compress_thread){
+
+    (void)arg;
+
+    zlog_thread_lower_priority();
+
+    for(;;){
+
+        zlog_mutex_lock(&zlog_compress_lock);
+
+        LogCompressJob *job = zlog_compressor.jobs;
+
+        if(job){
+            zlog_compressor.jobs = job->next;
+            if(!zlog_compressor.jobs) zlog_compressor.last = NULL;
+        }
+
+        zlog_mutex_unlock(&zlog_compress_lock);
+
+        if(job){
+            zlog_compress_segment(job);
+            zlog_free(job);
+            atomic_fetch_sub(&zlog_compressor.pending, 1);
+        }else if(!atomic_load(&zlog_compressor.running)){
+            break;
+        }else {
+            zlog_sleep_us(ZLOG_COMPRESS_IDLE_US);
+        }
+
+    }
+
+    ZLOG_THREAD_RETURN;
+
+}
+
+/*!
+    Function that stops the compression thread once the queued segments have been compressed, registered with atexit()
+*/
+
+static void zlog_compress_stop(){
+
+    if(!atomic_exchange(&zlog_compressor.running, 0)) return;
+
+    zlog_thread_join(zlog_compressor.thread);
+
+}
+
+/*!
+    Function that queues the segment just rotated for the compression thread, starting the thread on the first call
+    @param file the file sink, its lock is held
+*/
+
+static void zlog_compress_schedule(LogFile* file){
+
+    static int registered = 0;
+
+    LogCompressJob *job = (LogCompressJob*)zlog_malloc(sizeof(LogCompressJob));
+
+    if(!job){
+        fprintf(stderr, "[ERROR] Couldn't compress the rotated file: %s.1\n", file->path);
+        return;
+    }
+
+    job->file = file;
+    job->generation = file->rotations;
+    job->next = NULL;
+
+    atomic_fetch_add(&zlog_compressor.pending, 1);
+
+    zlog_mutex_lock(&zlog_compress_lock);
+
+    if(zlog_compressor.last){
+        zlog_compressor.last->next = job;
+    }else {
+        zlog_compressor.jobs = job;
+    }
+
+    zlog_compressor.last = job;
+
+    if(!atomic_load(&zlog_compressor.running)){
+
+        atomic_store(&zlog_compressor.running, 1);
+
+        if(zlog_thread_create(&zlog_compressor.thread, zlog_compress_thread, NULL) != 0){
+            atomic_store(&zlog_compressor.running, 0);
+            fprintf(stderr, "[ERROR] Couldn't start the compression thread\n");
+        }else if(!registered){
+            atexit(zlog_compress_stop);
+            registered = 1;
+        }
+
+    }
+
+    zlog_mutex_unlock(&zlog_compress_lock);
+
+}
+
+/*!
+    Function that waits until every queued segment has been compressed
+*/
+
+static void zlog_compress_wait(){
+
+    while(atomic_load(&zlog_compressor.pending) > 0 && atomic_load(&zlog_compressor.running)){
+        zlog_sleep_us(1000);
+    }
+
+}
+
+/*
+    Size of the raw args a record of the backtrace holds before its storage grows
+*/
+
+#ifndef ZLOG_BACKTRACE_ARGS_SIZE
+#define ZLOG_BACKTRACE_ARGS_SIZE 128
+#endif
+
+/*!
+    Record kept by the backtrace, its args are stored raw like in binary mode and formatted only when the ring is dumped
+
+    @param site the callsite of the log
+    @param level the level of the log
+    @param clock the clock of the logger when the record has been pushed
+    @param ticks the ticks of the clock, converted to wall time when the ring is dumped
+    @param args a copy of the format string with its terminator, the path of the file of a zflog record with its terminator,
+                followed by the raw args written by zlog_args_encode()
+    @param path the offset of the path of the file of a zflog record, 0 for the records written to the sinks of the logger
+    @param offset the offset of the raw args, after the format string and the path
+    @param length the number of bytes of the format string, the path and the raw args
+    @param capacity the number of bytes that args can hold, allocated with the ring and grown by the bigger records
+*/
+typedef struct {
+
+    const LogCallsite * site;
+    LogLevel level;
+    LogClockSource clock;
+    uint64_t ticks;
+    char * args;
+    size_t path;
+    size_t offset;
+    size_t length;
+    size_t capacity;
+
+}LogBacktraceEntry;
+
+/*!
+    Ring of the last records below the minimum level of a logger
+
+    @param lock the mutex taken to push and dump the records
+    @param enabled whether the records below the minimum level are pushed to the ring
+    @param capacity the number of records the ring holds
+    @param next the slot of the next record
+    @param count the number of records in the ring
+    @param entries the records
+*/
+typedef struct LogBacktrace {
+
+    LogMutex lock;
+    atomic_int enabled;
+    size_t capacity;
+    size_t next;
+    size_t count;
+    LogBacktraceEntry entries[];
+
+}LogBacktrace;
+
+/*!
+    Function that frees a ring of the backtrace and the args of its records
+    @param backtrace the ring
+*/
+
+static void zlog_backtrace_free(LogBacktrace* backtrace){
+
+    for(size_t i = 0; i < backtrace->capacity; i++){
+        zlog_free(backtrace->entries[i].args);
+    }
+
+    zlog_mutex_destroy(&backtrace->lock);
+    zlog_free(backtrace);
+
+}
+
+/*
+    Lock taken to enable and disable the backtrace of the loggers
+*/
+
+static LogMutex zlog_backtrace_lock = ZLOG_MUTEX_INIT;
+
+static void zlog_update_accept_level(zlogger* logger){
+
+    LogBacktrace *backtrace = atomic_load(&logger->backtrace);
+    int enabled = backtrace && atomic_load(&backtrace->enabled);
+
+    atomic_store(&logger->accept_level, enabled ? L_TRACE : atomic_load(&logger->min_level));
+
+}
+
+int zlogger_enable_backtrace(zlogger* logger, size_t capacity){
+
+    if(capacity == 0) return -1;
+
+    zlog_mutex_lock(&zlog_backtrace_lock);
+
+    LogBacktrace *backtrace = atomic_load(&logger->backtrace);
+    LogBacktrace *replaced = NULL;
+
+    if(backtrace && backtrace->capacity == capacity){
+        atomic_store(&backtrace->enabled, 1);
+    }else {
+
+        LogBacktrace *ring = (LogBacktrace*)zlog_calloc(1, sizeof(LogBacktrace) + capacity * sizeof(LogBacktraceEntry));
+
+        if(!ring){
+            zlog_mutex_unlock(&zlog_backtrace_lock);
+            fprintf(stderr, "[ERROR] Couldn't allocate the backtrace of %zu records\n", capacity);
+            return -1;
+        }
+
+        for(size_t i = 0; i < capacity; i++){
+            ring->entries[i].args = (char*)zlog_malloc(ZLOG_BACKTRACE_ARGS_SIZE);
+            ring->entries[i].capacity = ring->entries[i].args ? ZLOG_BACKTRACE_ARGS_SIZE : 0;
+        }
+
+        zlog_mutex_init(&ring->lock);
+        ring->capacity = capacity;
+        atomic_store(&ring->enabled, 1);
+
+        replaced = atomic_exchange(&logger->backtrace, ring);
+
+    }
+
+    zlog_update_accept_level(logger);
+
+    zlog_mutex_unlock(&zlog_backtrace_lock);
+
+    /* the records of the replaced ring are dropped, it is freed once the log calls that may be pushing to it have ended */
+    if(replaced){
+        zlog_read_synchronize();
+        zlog_backtrace_free(replaced);
+    }
+
+    return 0;
+
+}
+
+void zlogger_disable_backtrace(zlogger* logger){
+
+    zlog_mutex_lock(&zlog_backtrace_lock);
+
+    LogBacktrace *backtrace = atomic_load(&logger->backtrace);
+
+    if(backtrace){
+        atomic_store(&backtrace->enabled, 0);
+        zlog_mutex_lock(&backtrace->lock);
+        backtrace->count = 0;
+        backtrace->next = 0;
+        zlog_mutex_unlock(&backtrace->lock);
+    }
+
+    zlog_update_accept_level(logger);
+
+    zlog_mutex_unlock(&zlog_backtrace_lock);
+
+}
+
+static int zlog_enable_backtrace(size_t capacity){
+    return zlogger_enable_backtrace(&zlog, capacity);
+}
+
+static void zlog_disable_backtrace(){
+    zlogger_disable_backtrace(&zlog);
+}
+
+static void zlog_dump_backtrace(){
+    zlogger_dump_backtrace(&zlog);
+}
+
+static uint8_t zlog_get_flag(){
+    return atomic_load(&zlog.flags);
+}
+
+void zlogger_set_flags(zlogger* logger, LogFlags flags){
+
+    atomic_fetch_or(&logger->flags, (uint8_t)flags);
+
+}
+
+void zlogger_unset_flags(zlogger* logger, LogFlags flags){
+
+    atomic_fetch_and(&logger->flags, (uint8_t)~flags);
+
+}
+
+static void zlog_set_flags(LogFlags flags){
+    zlogger_set_flags(&zlog, flags);
+}
+
+static void zlog_unset_flags(LogFlags flags){
+    zlogger_unset_flags(&zlog, flags);
+}
+
+static void zlog_flip_flags(LogFlags flags){
+
+    atomic_fetch_xor(&zlog.flags, (uint8_t)flags);
+
+}
+
+void zlogger_set_level(zlogger* logger, LogLevel level){
+    atomic_store(&logger->level, level);
+}
+
+void zlogger_set_min_level(zlogger* logger, LogLevel level){
+
+    zlog_mutex_lock(&zlog_backtrace_lock);
+
+    atomic_store(&logger->min_level, level);
+    zlog_update_accept_level(logger);
+
+    zlog_mutex_unlock(&zlog_backtrace_lock);
+
+}
+
+static void zlog_set_level(LogLevel level){
+    zlogger_set_level(&zlog, level);
+}
+
+static void zlog_set_min_level(LogLevel level){
+    zlogger_set_min_level(&zlog, level);
+}
+
+static void zlog_set_file_write_mode(const char * mode){
+    atomic_store(&zlog.mode, mode);
+}
+
+/*
+    Bits of the state of a reader: the nesting of its log calls in progress and the phase of the outermost one
+*/
+
+#define ZLOG_READ_NESTING   0x7fffffffu
+#define ZLOG_READ_PHASE     0x80000000u
+
+/*!
+    Log calls in progress of a thread, in thread local storage and registered for zlog_read_synchronize() to scan. 
+    Only the thread writes its state, so a call doesn't write a cache line shared with the other threads
+
+    @param state the nesting of the calls in progress and the phase of the outermost one, the nesting is 0 outside of a call
+    @param registered whether the reader is in the registry
+    @param next the next reader of the registry
+*/
+typedef struct LogReader {
+
+    atomic_uint state;
+    int registered;
+    struct LogReader * next;
+
+}LogReader;
+
+static ZLOG_THREAD_LOCAL LogReader zlog_reader;
+
+/*
+    Phase given to the outermost calls with a nesting of 1, flipped twice by every grace period
+*/
+
+static atomic_uint zlog_read_phase = 1;
+
+/*
+    Registry of the readers of the threads, and lock taken to change it and to wait for a grace period
+*/
+
+static LogReader * zlog_readers;
+static LogMutex zlog_read_lock = ZLOG_MUTEX_INIT;
+
+/*!
+    Function called when a thread with a reader exits, or called again if the thread logs after it, 
+    removes the reader from the registry before the thread local storage is released
+    @param reader the reader of the thread
+*/
+
+static void zlog_reader_close(LogReader* reader){
+
+    zlog_mutex_lock(&zlog_read_lock);
+
+    LogReader **link = &zlog_readers;
+
+    while(*link && *link != reader) link = &(*link)->next;
+    if(*link) *link = reader->next;
+
+    reader->registered = 0;
+
+    zlog_mutex_unlock(&zlog_read_lock);
+
+}
+
+#if defined _WIN32
+
+static DWORD zlog_reader_key = FLS_OUT_OF_INDEXES;
+
+static VOID WINAPI zlog_reader_exit(PVOID reader){
+    if(reader) zlog_reader_close((LogReader*)reader);
+}
+
+#else
+
+static pthread_key_t zlog_reader_key;
+static int zlog_reader_key_created;
+
+static void zlog_reader_exit(void* reader){
+    zlog_reader_close((LogReader*)reader);
+}
+
+#endif
+
+/*!
+    Function that adds the reader of the thread to the registry, called by the first log call of the thread
+    @param reader the reader of the thread
+*/
+
+static void zlog_reader_register(LogReader* reader){
+
+    zlog_mutex_lock(&zlog_read_lock);
+
+    #if defined _WIN32
+        if(zlog_reader_key == FLS_OUT_OF_INDEXES) zlog_reader_key = FlsAlloc(zlog_reader_exit);
+        if(zlog_reader_key != FLS_OUT_OF_INDEXES) FlsSetValue(zlog_reader_key, reader);
+    #else
+        if(!zlog_reader_key_created) zlog_reader_key_created = pthread_key_create(&zlog_reader_key, zlog_reader_exit) == 0;
+        if(zlog_reader_key_created) pthread_setspecific(zlog_reader_key, reader);
+    #endif
+
+    reader->next = zlog_readers;
+    zlog_readers = reader;
+    reader->registered = 1;
+
+    zlog_mutex_unlock(&zlog_read_lock);
+
+}
+
+/*!
+    Function that marks the start of a call that reads the published sink lists and patterns of the loggers, 
+    they are freed only once every call that may have read them has ended. The calls can be nested. 
+    The outermost call stores the phase in the state of the thread with a sequentially consistent store, 
+    the only barrier of the call: the state is visible to zlog_read_synchronize() before the published pointers are read
+*/
+
+static void zlog_read_begin(){
+
+    LogReader *reader = &zlog_reader;
+
+    if(!reader->registered) zlog_reader_register(reader);
+
+    unsigned state = atomic_load_explicit(&reader->state, memory_order_relaxed);
+
+    if(state & ZLOG_READ_NESTING){
+        atomic_store_explicit(&reader->state, state + 1, memory_order_relaxed);
+    }else {
+        atomic_store(&reader->state, atomic_load_explicit(&zlog_read_phase, memory_order_relaxed));
+    }
+
+}
+
+static void zlog_read_end(){
+
+    LogReader *reader = &zlog_reader;
+    unsigned state = atomic_load_explicit(&reader->state, memory_order_relaxed);
+
+    atomic_store_explicit(&reader->state, state - 1, memory_order_release);
+
+}
+
+/*!
+    Function that flips the phase of the new calls and waits for the calls in progress started in the other phase
+*/
+
+static void zlog_read_flip(){
+
+    unsigned phase = atomic_fetch_xor(&zlog_read_phase, ZLOG_READ_PHASE) ^ ZLOG_READ_PHASE;
+
+    for(LogReader *reader = zlog_readers; reader; reader = reader->next){
+
+        unsigned state = atomic_load(&reader->state);
+
+        while((state & ZLOG_READ_NESTING) && ((state ^ phase) & ZLOG_READ_PHASE)){
+            zlog_thread_yield();
+            state = atomic_load(&reader->state);
+        }
+
+    }
+
+}
+
+/*!
+    Function that waits for the end of the calls that may have read a list or a pattern replaced before the call. 
+    The phase is flipped twice: a call that read the phase before the first flip but stored it after the scan 
+    of its thread has the phase of the first flip, so it is waited by the second one.
+    It must not be called between zlog_read_begin() and zlog_read_end()
+*/
+
+static void zlog_read_synchronize(){
+
+    zlog_mutex_lock(&zlog_read_lock);
+
+    zlog_read_flip();
+    zlog_read_flip();
+
+    zlog_mutex_unlock(&zlog_read_lock);
+
+}
+
+/*
+    Lock taken to change the sinks, the log calls read the published list without locking
+*/
+
+static LogMutex zlog_sinks_lock = ZLOG_MUTEX_INIT;
+
+/*!
+    Function that starts a change of the sinks of a logger: it takes the lock and returns a copy of the current list
+    @param logger the logger
+    @return the copy or NULL if the memory couldn't be allocated (the lock is released)
+*/
+
+static LogSinkList* zlog_sinks_begin(zlogger* logger){
+
+    zlog_mutex_lock(&zlog_sinks_lock);
+
+    LogSinkList *list = (LogSinkList*)zlog_malloc(sizeof(LogSinkList));
+
+    if(!list){
+        fprintf(stderr, "[ERROR] Couldn't allocate the sinks\n");
+        zlog_mutex_unlock(&zlog_sinks_lock);
+        return NULL;
+    }
+
+    const LogSinkList *current = atomic_load_explicit(&logger->sinks, memory_order_relaxed);
+
+    if(current){
+        memcpy(list, current, sizeof(LogSinkList));
+    }else {
+        list->count = 0;
+    }
+
+    return list;
+
+}
+
+/*!
+    Function that publishes the list changed after zlog_sinks_begin() and releases the lock, 
+    the replaced list is freed once the log calls that may be writing to it have ended.
+    The records of the asynchronous mode keep the streams and the files of the sinks, not the list
+    @param logger the logger
+    @param list the changed list
+*/
+
+static void zlog_sinks_commit(zlogger* logger, LogSinkList* list){
+
+    LogSinkList *replaced = atomic_exchange(&logger->sinks, list);
+
+    zlog_mutex_unlock(&zlog_sinks_lock);
+
+    if(replaced){
+        zlog_read_synchronize();
+        zlog_free(replaced);
+    }
+
+}
+
+/*!
+    Function that drops the list changed after zlog_sinks_begin() and releases the lock
+    @param list the changed list
+*/
+
+static void zlog_sinks_abort(LogSinkList* list){
+
+    zlog_free(list);
+
+    zlog_mutex_unlock(&zlog_sinks_lock);
+
+}
+
+static LogSink* zlog_sinks_find(LogSinkList* list, FILE* stream){
+
+    for(size_t i = 0; i < list->count; i++){
+        if(!list->sinks[i].file && list->sinks[i].stream == stream) return &list->sinks[i];
+    }
+
+    return NULL;
+
+}
+
+/*!
+    Function that replaces the output stream, the first sink of a logger, keeping its minimum level
+    @param logger the logger
+    @param sink the new output stream
+    @param owned set to whether the previous output stream has been opened by the logger
+    @return the previous output stream, NULL if there wasn't one
+*/
+
+static FILE* zlog_replace_output(zlogger* logger, LogSink sink, int* owned){
+
+    *owned = 0;
+
+    LogSinkList *list = zlog_sinks_begin(logger);
+    if(!list) return NULL;
+
+    FILE *previous = NULL;
+
+    if(list->count == 0 || list->sinks[0].file){
+
+        if(list->count == ZLOG_MAX_SINKS){
+            fprintf(stderr, "[ERROR] Too many sinks, the max is %d\n", ZLOG_MAX_SINKS);
+            zlog_sinks_abort(list);
+            return NULL;
+        }
+
+        memmove(list->sinks + 1, list->sinks, list->count * sizeof(LogSink));
+        list->count++;
+
+    }else {
+        previous = list->sinks[0].stream;
+        *owned = list->sinks[0].owned;
+        sink.min_level = list->sinks[0].min_level;
+    }
+
+    list->sinks[0] = sink;
+
+    zlog_sinks_commit(logger, list);
+
+    return previous;
+
+}
+
+static void zlog_open_file(const char* filename){
+
+    FILE *fp = fopen(filename, atomic_load(&zlog.mode));
+
+    if(!fp){
+        zlog_fatal("Couldn't open file: %s", filename);
+        exit(1);
+    }
+
+    int owned;
+    FILE *previous = zlog_replace_output(&zlog, (LogSink){ fp, L_TRACE, 0, 1, NULL }, &owned);
+
+    if(previous && owned){
+        zlog_async_wait();
+        fclose(previous);
+    }
+
+}
+
+static void zlog_close_stream(){
+
+    int owned;
+    FILE *previous = zlog_replace_output(&zlog, (LogSink){ stderr, L_TRACE, 1, 0, NULL }, &owned);
+
+    if(previous){
+        zlog_async_wait();
+        fclose(previous);
+    }
+
+}
+
+void zlogger_set_output_stream(zlogger* logger, FILE* stream){
+
+    int owned;
+    FILE *previous = zlog_replace_output(logger, (LogSink){ stream, L_TRACE, 1, 0, NULL }, &owned);
+
+    if(previous && owned){
+        zlog_async_wait();
+        fclose(previous);
+    }
+
+}
+
+static void zlog_set_output_stream(FILE* Stream){
+    zlogger_set_output_stream(&zlog, Stream);
+}
+
+static int zlog_push_sink(zlogger* logger, LogSink sink){
+
+    LogSinkList *list = zlog_sinks_begin(logger);
+    if(!list) return -1;
+
+    if(list->count == ZLOG_MAX_SINKS){
+        fprintf(stderr, "[ERROR] Too many sinks, the max is %d\n", ZLOG_MAX_SINKS);
+        zlog_sinks_abort(list);
+        return -1;
+    }
+
+    list->sinks[list->count++] = sink;
+
+    zlog_sinks_commit(logger, list);
+
+    return 0;
+
+}
+
+int zlogger_add_sink(zlogger* logger, FILE* stream, LogLevel min_level, int use_colors){
+
+    return zlog_push_sink(logger, (LogSink){ stream, min_level, use_colors, 0, NULL });
+
+}
+
+int zlogger_add_rotating_file_sink(zlogger* logger, const char* filename, LogLevel min_level, const LogRotation* rotation){
+
+    LogFile *file = zlog_file_open(filename, atomic_load(&logger->mode), rotation);
+    if(!file) return -1;
+
+    if(zlog_push_sink(logger, (LogSink){ NULL, min_level, 0, 0, file }) != 0){
+        zlog_file_free(file);
+        return -1;
+    }
+
+    return 0;
+
+}
+
+int zlogger_add_file_sink(zlogger* logger, const char* filename, LogLevel min_level){
+
+    return zlogger_add_rotating_file_sink(logger, filename, min_level, NULL);
+
+}
+
+void zlogger_remove_sink(zlogger* logger, FILE* stream){
+
+    LogSinkList *list = zlog_sinks_begin(logger);
+    if(!list) return;
+
+    LogSink *sink = zlog_sinks_find(list, stream);
+
+    if(!sink){
+        zlog_sinks_abort(list);
+        return;
+    }
+
+    int owned = sink->owned;
+
+    memmove(sink, sink + 1, (size_t)(list->sinks + list->count - (sink + 1)) * sizeof(LogSink));
+    list->count--;
+
+    zlog_sinks_commit(logger, list);
+
+    if(owned){
+        zlog_async_wait();
+        fclose(stream);
+    }
+
+}
+
+void zlogger_set_sink_level(zlogger* logger, FILE* stream, LogLevel min_level){
+
+    LogSinkList *list = zlog_sinks_begin(logger);
+    if(!list) return;
+
+    LogSink *sink = zlog_sinks_find(list, stream);
+
+    if(!sink){
+        zlog_sinks_abort(list);
+        return;
+    }
+
+    sink->min_level = min_level;
+
+    zlog_sinks_commit(logger, list);
+
+}
+
+void zlogger_set_sink_colors(zlogger* logger, FILE* stream, int use_colors){
+
+    LogSinkList *list = zlog_sinks_begin(logger);
+    if(!list) return;
+
+    LogSink *sink = zlog_sinks_find(list, stream);
+
+    if(!sink){
+        zlog_sinks_abort(list);
+        return;
+    }
+
+    sink->use_colors = use_colors;
+
+    zlog_sinks_commit(logger, list);
+
+}
+
+static int zlog_add_sink(FILE* stream, LogLevel min_level, int use_colors){
+    return zlogger_add_sink(&zlog, stream, min_level, use_colors);
+}
+
+static int zlog_add_file_sink(const char* filename, LogLevel min_level){
+    return zlogger_add_file_sink(&zlog, filename, min_level);
+}
+
+static void zlog_remove_sink(FILE* stream){
+    zlogger_remove_sink(&zlog, stream);
+}
+
+void zlogger_remove_file_sink(zlogger* logger, const char* filename){
+
+    LogSinkList *list = zlog_sinks_begin(logger);
+    if(!list) return;
+
+    LogFile *removed[ZLOG_MAX_SINKS];
+    size_t count = 0;
+    size_t kept = 0;
+
+    for(size_t i = 0; i < list->count; i++){
+        LogFile *file = list->sinks[i].file;
+        if(file && strcmp(file->path, filename) == 0){
+            removed[count++] = file;
+        }else {
+            list->sinks[kept++] = list->sinks[i];
+        }
+    }
+
+    if(count == 0){
+        zlog_sinks_abort(list);
+        return;
+    }
+
+    list->count = kept;
+
+    zlog_sinks_commit(logger, list);
+
+    zlog_async_wait();
+    zlog_compress_wait();
+
+    for(size_t i = 0; i < count; i++){
+        zlog_file_free(removed[i]);
+    }
+
+}
+
+static int zlog_add_rotating_file_sink(const char* filename, LogLevel min_level, const LogRotation* rotation){
+    return zlogger_add_rotating_file_sink(&zlog, filename, min_level, rotation);
+}
+
+static void zlog_remove_file_sink(const char* filename){
+    zlogger_remove_file_sink(&zlog, filename);
+}
+
+static void zlog_set_sink_level(FILE* stream, LogLevel min_level){
+    zlogger_set_sink_level(&zlog, stream, min_level);
+}
+
+static void zlog_set_sink_colors(FILE* stream, int use_colors){
+    zlogger_set_sink_colors(&zlog, stream, use_colors);
+}
+
+static void zlog_clear_file(const char* filename){
+
+    FILE *fp = fopen(filename, "w");
+    fclose(fp);
+
+}
+
+/*
+    Look up table of the format specifiers accepted inside a pattern
+*/
+
+static const struct {
+    const char * spec;
+    PatternType type;
+} pattern_spec[] = {
+    { "D", DAY },
+    { "M", MONTH },
+    { "Y", YEAR },
+    { "h", HOUR },
+    { "m", MINUTE },
+    { "s", SECOND },
+    { "ms", MILLISECOND },
+    { "us", MICROSECOND },
+    { "ns", NANOSECOND },
+    { "T", THREAD },
+    { "C", CPU },
+    { "f", FUNCTION },
+    { "l", LOCATION },
+    { "n", NAME },
+    { "t", TAG }
+};
+
+/*!
+    Function that compiles a pattern into literal spans and fields
+    @param pattern the pattern to compile
+    @param out the compiled pattern
+    @param error the description of the error if the pattern is malformed
+    @param position the position in the pattern where the error has been found
+    @return 0 on success, -1 if the pattern is malformed
+*/
+
+static int zlog_compile_pattern(const char* pattern, CompiledPattern* out, const char** error, size_t* position){
+
+    size_t length = strlen(pattern);
+
+    if(length > UINT16_MAX){
+        *error = "pattern too long";
+        *position = UINT16_MAX;
+        return -1;
+    }
+
+    out->count = 0;
+    out->precise = 0;
+
+    size_t i = 0;
+
+    while(i < length){
+
+        if(out->count == ZLOG_PATTERN_MAX_OPS){
+            *error = "too many fields";
+            *position = i;
+            return -1;
+        }
+
+        PatternOp *op = &out->ops[out->count];
+
+        if(pattern[i] == '{'){
+
+            const char *close = strchr(pattern + i + 1, '}');
+
+            if(!close){
+                *error = "missing closing bracket";
+                *position = i;
+                return -1;
+            }
+
+            size_t spec_len = (size_t)(close - (pattern + i + 1));
+            size_t k;
+
+            for(k = 0; k < sizeof(pattern_spec) / sizeof(pattern_spec[0]); k++){
+                if(strlen(pattern_spec[k].spec) == spec_len && 
+                   strncmp(pattern_spec[k].spec, pattern + i + 1, spec_len) == 0){
+                    break;
+                }
+            }
+
+            if(k == sizeof(pattern_spec) / sizeof(pattern_spec[0])){
+                *error = "unknown format specifier";
+                *position = i;
+                return -1;
+            }
+
+            op->type = pattern_spec[k].type;
+            op->offset = 0;
+            op->length = 0;
+
+            if(op->type >= MILLISECOND && op->type <= NANOSECOND) out->precise = 1;
+
+            i += spec_len + 2;
+
+        }else {
+
+            size_t start = i;
+
+            while(i < length && pattern[i] != '{') i++;
+
+            op->type = LITERAL;
+            op->offset = (uint16_t)start;
+            op->length = (uint16_t)(i - start);
+
+        }
+
+        out->count++;
+
+    }
+
+    return 0;
+
+}
+
+/*
+    Counter of the compiled patterns, gives every pattern a unique id
+*/
+
+static _Atomic(uint64_t) zlog_pattern_ids;
+
+/*
+    Lock taken to replace the pattern of a logger, the log calls read the published pattern without locking
+*/
+
+static LogMutex zlog_pattern_lock = ZLOG_MUTEX_INIT;
+
+static void zlog_site_prefixes_retire(uint64_t pattern);
+
+int zlogger_set_pattern(zlogger* logger, const char* pattern){
+
+    CompiledPattern *compiled = (CompiledPattern*)zlog_malloc(sizeof(CompiledPattern));
+    char *source = (char*)zlog_malloc(strlen(pattern) + 1);
+
+    if(!compiled || !source){
+        zlog_free(compiled);
+        zlog_free(source);
+        fprintf(stderr, "[ERROR] Couldn't allocate the pattern: %s\n", pattern);
+        return -1;
+    }
+
+    strcpy(source, pattern);
+
+    const char *error = NULL;
+    size_t position = 0;
+
+    if(zlog_compile_pattern(source, compiled, &error, &position) != 0){
+        fprintf(stderr, "[ERROR] Invalid pattern \"%s\": %s at position %zu\n", pattern, error, position);
+        zlog_free(compiled);
+        zlog_free(source);
+        return -1;
+    }
+
+    compiled->source = source;
+    compiled->id = atomic_fetch_add(&zlog_pattern_ids, 1) + 1;
+
+    zlog_mutex_lock(&zlog_pattern_lock);
+
+    CompiledPattern *replaced = atomic_exchange(&logger->compiled, compiled);
+    atomic_store(&logger->pattern, source);
+
+    zlog_mutex_unlock(&zlog_pattern_lock);
+
+    if(replaced){
+        zlog_read_synchronize();
+        zlog_site_prefixes_retire(replaced->id);
+        zlog_free(replaced->source);
+        zlog_free(replaced);
+    }
+
+    return 0;
+
+}
+
+static int zlog_set_pattern(const char* pattern){
+    return zlogger_set_pattern(&zlog, pattern);
+}
+
+/*!
+    Function that sets up the fields of a logger
+    @param logger the logger
+    @param log_name the name of the logger
+    @param config the configuration of the logger, NULL for the defaults
+    @return 0 on success, -1 if the pattern is malformed or the sinks couldn't be allocated
+*/
+
+static int zlog_setup(zlogger* logger, const char* log_name, const LogConfig* config){
+
+    logger->name = log_name;
+    atomic_store(&logger->level, L_INFO);
+    atomic_store(&logger->min_level, config ? config->min_level : L_TRACE);
+    atomic_store(&logger->flags, config ? config->flags : ZLOG_ALL);
+    atomic_store(&logger->mode, config && config->mode ? config->mode : "a");
+    atomic_store(&logger->clock, ZLOG_CLOCK_MONOTONIC);
+    atomic_store(&logger->overflow, ZLOG_OVERFLOW_BLOCK);
+    atomic_store(&logger->dropped, 0);
+    atomic_store(&logger->spilled, 0);
+    atomic_store(&logger->blocked_ns, 0);
+    atomic_store(&logger->high_water, 0);
+    atomic_store(&logger->reported, 0);
+    atomic_store(&logger->report_time, 0);
+
+    zlogger_disable_backtrace(logger);
+
+    if(zlogger_set_pattern(logger, config && config->pattern ? config->pattern : "{D}/{M}/{Y} {h}:{m}:{s} | {f} @ {l} | {n} | {t} > ") != 0){
+        return -1;
+    }
+
+    LogSinkList *sinks = zlog_sinks_begin(logger);
+    if(!sinks) return -1;
+
+    sinks->count = 1;
+    sinks->sinks[0] = config ? (LogSink){ config->stream ? config->stream : stderr, L_TRACE, config->use_colors, 0, NULL }
+                             : (LogSink){ stderr, L_TRACE, 1, 0, NULL };
+
+    zlog_sinks_commit(logger, sinks);
+
+    return 0;
+
+}
+
+void zlog_init(const char* log_name){
+
+    zlog.set_level = zlog_set_level;
+    zlog.set_min_level = zlog_set_min_level;
+    zlog.set_file_write_mode = zlog_set_file_write_mode;
+    zlog.open_file = zlog_open_file;
+    zlog.clear_file = zlog_clear_file;
+    zlog.close_stream = zlog_close_stream;
+    zlog.set_output_stream = zlog_set_output_stream;
+    zlog.add_sink = zlog_add_sink;
+    zlog.add_file_sink = zlog_add_file_sink;
+    zlog.add_rotating_file_sink = zlog_add_rotating_file_sink;
+    zlog.remove_sink = zlog_remove_sink;
+    zlog.remove_file_sink = zlog_remove_file_sink;
+    zlog.set_sink_level = zlog_set_sink_level;
+    zlog.set_sink_colors = zlog_set_sink_colors;
+    zlog.flush = zlog_flush;
+    zlog.close_files = zlog_close_files;
+    zlog.enable_backtrace = zlog_enable_backtrace;
+    zlog.disable_backtrace = zlog_disable_backtrace;
+    zlog.dump_backtrace = zlog_dump_backtrace;
+    zlog.set_clock = zlog_set_clock;
+    zlog.set_overflow_policy = zlog_set_overflow_policy;
+    zlog.get_async_stats = zlog_get_async_stats;
+    zlog.get_flags = zlog_get_flag;
+    zlog.set_flags = zlog_set_flags;
+    zlog.unset_flags = zlog_unset_flags;
+    zlog.flip_flags = zlog_flip_flags;
+    zlog.set_pattern = zlog_set_pattern;
+
+    zlog_setup(&zlog, log_name, NULL);
+
+    #if defined _WIN32
+        zlog_enable_console_colors();
+    #endif
+ 
+}
+
+zlogger* zlog_create(const char* name, const LogConfig* config){
+
+    zlogger *logger = (zlogger*)zlog_calloc(1, sizeof(zlogger));
+
+    if(!logger){
+        fprintf(stderr, "[ERROR] Couldn't allocate the logger: %s\n", name);
+        return NULL;
+    }
+
+    if(zlog_setup(logger, name, config) != 0){
+        zlog_destroy(logger);
+        return NULL;
+    }
+
+    #if defined _WIN32
+        zlog_enable_console_colors();
+    #endif
+
+    return logger;
+
+}
+
+void zlog_destroy(zlogger* logger){
+
+    if(!logger || logger == &zlog) return;
+
+    zlog_async_wait();
+    zlog_compress_wait();
+
+    LogSinkList *sinks = atomic_load(&logger->sinks);
+
+    for(size_t i = 0; sinks && i < sinks->count; i++){
+
+        LogFile *file = sinks->sinks[i].file;
+
+        if(file){
+            zlog_file_free(file);
+        }else if(sinks->sinks[i].owned){
+            fclose(sinks->sinks[i].stream);
+        }
+
+    }
+
+    zlog_free(sinks);
+
+    CompiledPattern *compiled = atomic_load(&logger->compiled);
+
+    if(compiled){
+        zlog_site_prefixes_retire(compiled->id);
+        zlog_free(compiled->source);
+        zlog_free(compiled);
+    }
+
+    LogBacktrace *backtrace = atomic_load(&logger->backtrace);
+
+    if(backtrace) zlog_backtrace_free(backtrace);
+
+    zlog_free(logger);
+
+}
+
+/*!
+    Function that sets the color of the field that is going to be rendered
+    @param buffer the buffer of the record
+    @param type the type of the field
+    @param level the level of the log
+*/
+
+static void zlog_begin_color(LogBuffer* buffer, PatternType type, LogLevel level){
+
+    if(type == LITERAL) return;
+
+    if(type == TAG){
+        zlog_buffer_puts(buffer, log_color[level]);
+    }else if(ZLOG_IS_TIME_FIELD(type)){
+        zlog_buffer_puts(buffer, ANSI_COLOR_YELLOW);
+    }else {
+        zlog_buffer_puts(buffer, ANSI_COLOR_MAGENTA);
+    }
+
+}
+
+/*!
+    Function that resets the color after a field, the literals of the pattern are never colored
+    @param buffer the buffer of the record
+    @param type the type of the field
+*/
+
+static void zlog_end_color(LogBuffer* buffer, PatternType type){
+
+    if(type != LITERAL) zlog_buffer_puts(buffer, ANSI_COLOR_RESET);
+
+}
+
+/*!
+    Function that renders the compiled pattern at the start of the record
+    @param buffer the buffer of the record
+    @param pattern the compiled pattern
+    @param name the name of the logger
+    @param level the level of the log
+    @param time the time of the log
+    @param filename the file where the log is being called
+    @param fun_name the function where the log is being called
+    @param line the line where the log is being called
+    @param use_colors whether the fields are rendered with colors
+    @param utc whether the date and the time are rendered in UTC
+*/
+
+static void zlog_log_pattern(LogBuffer* buffer, const CompiledPattern* pattern, const char* name, LogLevel level, const struct timespec* time, const char * filename, const char* fun_name, size_t line, int use_colors, int utc){
+
+    const LogTimeCache *time_fields = zlog_time_fields(time->tv_sec, utc);
+
+    for(size_t i = 0; i < pattern->count; i++){
+
+        const PatternOp *op = &pattern->ops[i];
+
+        if(use_colors) zlog_begin_color(buffer, op->type, level);
+
+        switch(op->type){
+            case DAY:
+            case MONTH:
+            case YEAR:
+            case HOUR:
+            case MINUTE:
+            case SECOND:
+            case MILLISECOND:
+            case MICROSECOND:
+            case NANOSECOND:
+            case THREAD:
+            case CPU:
+                zlog_buffer_append_field(buffer, op->type, time_fields, time->tv_nsec);
+                break;
+            case FUNCTION:
+                zlog_buffer_puts(buffer, fun_name);
+                break;
+            case LOCATION:
+                zlog_buffer_append_location(buffer, filename, line);
+                break;
+            case NAME:
+                zlog_buffer_puts(buffer, name);
+                break;
+            case TAG:
+                zlog_buffer_append_tag(buffer, level);
+                break;
+            case LITERAL:
+                zlog_buffer_append(buffer, pattern->source + op->offset, op->length);
+                break;
+            default:
+                break;
+        }
+
+        if(use_colors) zlog_end_color(buffer, op->type);
+
+    }
+
+}
+
+
+/*
+    Type of the value consumed by a conversion specification of a format string
+*/
+
+typedef enum {
+    ZLOG_ARG_NONE,
+    ZLOG_ARG_INT,
+    ZLOG_ARG_UINT,
+    ZLOG_ARG_DOUBLE,
+    ZLOG_ARG_STRING,
+    ZLOG_ARG_POINTER
+}LogArgType;
+
+/*!
+    Conversion specification of a format string, as parsed by zlog_next_spec()
+
+    @param start the '%' that starts the specification
+    @param end the first character after the specification
+    @param flags the flags of the specification
+    @param flags_length the number of flags
+    @param width the width, -1 if not given, -2 if given as an argument ('*')
+    @param precision the precision, -1 if not given, -2 if given as an argument ('*')
+    @param modifier the length modifier ("", "hh", "h", "l", "ll", "j", "z", "t", "L")
+    @param conversion the conversion character
+    @param type the type of the value consumed by the specification
+*/
+typedef struct {
+
+    const char * start;
+    const char * end;
+    const char * flags;
+    size_t flags_length;
+    int width;
+    int precision;
+    char modifier[3];
+    char conversion;
+    LogArgType type;
+
+}LogArgSpec;
+
+/*!
+    Function that finds and parses the next conversion specification of a format string
+    @param fmt the format string from where the search starts
+    @param spec the parsed specification
+    @return 1 if a specification has been found, 0 at the end of the string
+*/
+
+static int zlog_next_spec(const char* fmt, LogArgSpec* spec){
+
+    const char *p = strchr(fmt, '%');
+    if(!p) return 0;
+
+    spec->start = p++;
+
+    spec->flags = p;
+    while(*p && strchr("-+ #0'", *p)) p++;
+    spec->flags_length = (size_t)(p - spec->flags);
+
+    spec->width = -1;
+    if(*p == '*'){
+        spec->width = -2;
+        p++;
+    }else if(*p >= '0' && *p <= '9'){
+        spec->width = 0;
+        while(*p >= '0' && *p <= '9') spec->width = spec->width * 10 + (*p++ - '0');
+    }
+
+    spec->precision = -1;
+    if(*p == '.'){
+        p++;
+        if(*p == '*'){
+            spec->precision = -2;
+            p++;
+        }else {
+            spec->precision = 0;
+            while(*p >= '0' && *p <= '9') spec->precision = spec->precision * 10 + (*p++ - '0');
+        }
+    }
+
+    size_t modifier_length = 0;
+    if((p[0] == 'h' && p[1] == 'h') || (p[0] == 'l' && p[1] == 'l')){
+        modifier_length = 2;
+    }else if(*p && strchr("hljztLq", *p)){
+        modifier_length = 1;
+    }
+    memcpy(spec->modifier, p, modifier_length);
+    spec->modifier[modifier_length] = '\0';
+    if(spec->modifier[0] == 'q') strcpy(spec->modifier, "ll");
+    p += modifier_length;
+
+    spec->conversion = *p;
+    if(*p) p++;
+    spec->end = p;
+
+    switch(spec->conversion){
+        case 'd': case 'i':
+            spec->type = ZLOG_ARG_INT;
+            break;
+        case 'c':
+            spec->type = spec->modifier[0] == 'l' ? ZLOG_ARG_UINT : ZLOG_ARG_INT;
+            break;
+        case 'u': case 'o': case 'x': case 'X':
+            spec->type = ZLOG_ARG_UINT;
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            spec->type = ZLOG_ARG_DOUBLE;
+            break;
+        case 's':
+            spec->type = ZLOG_ARG_STRING;
+            break;
+        case 'p':
+            spec->type = ZLOG_ARG_POINTER;
+            break;
+        default:
+            spec->type = ZLOG_ARG_NONE;
+            break;
+    }
+
+    return 1;
+
+}
+
+/*!
+    Function that appends the raw bytes of the args of a message, as described by the format string.
+    Integers are stored on 8 bytes, floating point numbers as double, strings as their length on 4 bytes
+    followed by their characters, the '*' width and precision as int on 4 bytes before the value
+    @param buffer the buffer where the bytes are appended
+    @param fmt the format string
+    @param args the args of the message
+*/
+
+static void zlog_args_encode(LogBuffer* buffer, const char* fmt, va_list args){
+
+    LogArgSpec spec;
+
+    while(zlog_next_spec(fmt, &spec)){
+
+        int precision = spec.precision;
+
+        if(spec.width == -2){
+            int32_t width = va_arg(args, int);
+            zlog_buffer_append(buffer, (const char*)&width, sizeof(width));
+        }
+
+        if(spec.precision == -2){
+            int32_t value = va_arg(args, int);
+            precision = value;
+            zlog_buffer_append(buffer, (const char*)&value, sizeof(value));
+        }
+
+        const char *m = spec.modifier;
+
+        switch(spec.type){
+            case ZLOG_ARG_INT: {
+                int64_t value;
+                if(!strcmp(m, "hh"))        value = (signed char)va_arg(args, int);
+                else if(!strcmp(m, "h"))    value = (short)va_arg(args, int);
+                else if(!strcmp(m, "l"))    value = va_arg(args, long);
+                else if(!strcmp(m, "ll"))   value = va_arg(args, long long);
+                else if(!strcmp(m, "j"))    value = va_arg(args, intmax_t);
+                else if(!strcmp(m, "z"))    value = (int64_t)(ptrdiff_t)va_arg(args, size_t);
+                else if(!strcmp(m, "t"))    value = va_arg(args, ptrdiff_t);
+                else                        value = va_arg(args, int);
+                zlog_buffer_append(buffer, (const char*)&value, sizeof(value));
+                break;
+            }
+            case ZLOG_ARG_UINT: {
+                uint64_t value;
+                if(spec.conversion == 'c')  value = (uint64_t)va_arg(args, wint_t);
+                else if(!strcmp(m, "hh"))   value = (unsigned char)va_arg(args, unsigned int);
+                else if(!strcmp(m, "h"))    value = (unsigned short)va_arg(args, unsigned int);
+                else if(!strcmp(m, "l"))    value = va_arg(args, unsigned long);
+                else if(!strcmp(m, "ll"))   value = va_arg(args, unsigned long long);
+                else if(!strcmp(m, "j"))    value = va_arg(args, uintmax_t);
+                else if(!strcmp(m, "z"))    value = va_arg(args, size_t);
+                else if(!strcmp(m, "t"))    value = (uint64_t)va_arg(args, ptrdiff_t);
+                else                        value = va_arg(args, unsigned int);
+                zlog_buffer_append(buffer, (const char*)&value, sizeof(value));
+                break;
+            }
+            case ZLOG_ARG_DOUBLE: {
+                double value = !strcmp(m, "L") ? (double)va_arg(args, long double) : va_arg(args, double);
+                zlog_buffer_append(buffer, (const char*)&value, sizeof(value));
+                break;
+            }
+            case ZLOG_ARG_STRING: {
+                uint32_t length = 0;
+                if(!strcmp(m, "l")){
+                    const wchar_t *wide = va_arg(args, const wchar_t*);
+                    if(!wide) wide = L"(null)";
+                    while(wide[length] && (precision < 0 || length < (uint32_t)precision)) length++;
+                    zlog_buffer_append(buffer, (const char*)&length, sizeof(length));
+                    for(uint32_t i = 0; i < length; i++){
+                        char c = wide[i] < 128 ? (char)wide[i] : '?';
+                        zlog_buffer_append(buffer, &c, 1);
+                    }
+                }else {
+                    const char *str = va_arg(args, const char*);
+                    if(!str) str = "(null)";
+                    while(str[length] && (precision < 0 || length < (uint32_t)precision)) length++;
+                    zlog_buffer_append(buffer, (const char*)&length, sizeof(length));
+                    zlog_buffer_append(buffer, str, length);
+                }
+                break;
+            }
+            case ZLOG_ARG_POINTER: {
+                uint64_t value = (uint64_t)(uintptr_t)va_arg(args, void*);
+                zlog_buffer_append(buffer, (const char*)&value, sizeof(value));
+                break;
+            }
+            case ZLOG_ARG_NONE:
+                if(spec.conversion == 'n') (void)va_arg(args, void*);
+                break;
+        }
+
+        fmt = spec.end;
+
+    }
+
+}
+
+/*!
+    Function that formats a message from the raw bytes of its args written by zlog_args_encode(),
+    used by the backtrace and by the tools that read the binary files
+    @param buffer the buffer where the message is appended
+    @param fmt the format string
+    @param args the raw bytes of the args
+    @param length the number of raw bytes
+    @return 0 on success, -1 if the raw bytes are truncated
+*/
+
+static int zlog_args_decode(LogBuffer* buffer, const char* fmt, const char* args, size_t length){
+
+    LogArgSpec spec;
+    const char *end = args + length;
+
+    #define ZLOG_READ_ARG(value) \
+        do { if((size_t)(end - args) < sizeof(value)) return -1; memcpy(&(value), args, sizeof(value)); args += sizeof(value); } while(0)
+
+    while(zlog_next_spec(fmt, &spec)){
+
+        zlog_buffer_append(buffer, fmt, (size_t)(spec.start - fmt));
+        fmt = spec.end;
+
+        if(spec.type == ZLOG_ARG_NONE){
+            if(spec.conversion == '%') zlog_buffer_append(buffer, "%", 1);
+            continue;
+        }
+
+        int32_t width = spec.width;
+        int32_t precision = spec.precision;
+
+        if(spec.width == -2) ZLOG_READ_ARG(width);
+        if(spec.precision == -2) ZLOG_READ_ARG(precision);
+
+        char format[64];
+        size_t n = 0;
+
+        format[n++] = '%';
+        memcpy(format + n, spec.flags, spec.flags_length < 8 ? spec.flags_length : 8);
+        n += spec.flags_length < 8 ? spec.flags_length : 8;
+        if(width != -1) n += (size_t)snprintf(format + n, sizeof(format) - n, "%d", (int)width);
+        if(precision >= 0 && spec.type != ZLOG_ARG_STRING) n += (size_t)snprintf(format + n, sizeof(format) - n, ".%d", (int)precision);
+
+        switch(spec.type){
+            case ZLOG_ARG_INT:
+            case ZLOG_ARG_UINT: {
+                int64_t value;
+                ZLOG_READ_ARG(value);
+                if(spec.conversion == 'c'){
+                    snprintf(format + n, sizeof(format) - n, "%sc", spec.type == ZLOG_ARG_UINT ? "l" : "");
+                    if(spec.type == ZLOG_ARG_UINT) zlog_buffer_printf(buffer, format, (wint_t)value);
+                    else zlog_buffer_printf(buffer, format, (int)value);
+                }else {
+                    snprintf(format + n, sizeof(format) - n, "ll%c", spec.conversion);
+                    zlog_buffer_printf(buffer, format, (long long)value);
+                }
+                break;
+            }
+            case ZLOG_ARG_DOUBLE: {
+                double value;
+                ZLOG_READ_ARG(value);
+                snprintf(format + n, sizeof(format) - n, "%c", spec.conversion);
+                zlog_buffer_printf(buffer, format, value);
+                break;
+            }
+            case ZLOG_ARG_STRING: {
+                uint32_t size;
+                ZLOG_READ_ARG(size);
+                if((size_t)(end - args) < size) return -1;
+                snprintf(format + n, sizeof(format) - n, ".*s");
+                zlog_buffer_printf(buffer, format, (int)size, args);
+                args += size;
+                break;
+            }
+            case ZLOG_ARG_POINTER: {
+                uint64_t value;
+                ZLOG_READ_ARG(value);
+                snprintf(format + n, sizeof(format) - n, "p");
+                zlog_buffer_printf(buffer, format, (void*)(uintptr_t)value);
+                break;
+            }
+            default:
+                break;
+        }
+
+    }
+
+    #undef ZLOG_READ_ARG
+
+    zlog_buffer_puts(buffer, fmt);
+
+    return 0;
+
+}
+
+/*
+    Types of the records of a binary file, every record starts with its type on 1 byte.
+    The numbers are stored with the byte order of the machine that wrote the file.
+
+    ZLOG_BINARY_HEADER:  "ZLOG", u16 version, u16 byte order mark (0x0102), 
+                         u16 length + name of the logger, u16 length + pattern
+    ZLOG_BINARY_SITE:    u32 id, u32 line, u16 length + file, u16 length + function, u32 length + format string
+    ZLOG_BINARY_CLOCK:   u8 clock, u64 ticks, i64 wall nanoseconds, u64 scale (32.32 fixed point), 
+                         the calibration that converts the ticks of the next messages
+    ZLOG_BINARY_MESSAGE: u32 id of the site, u8 level, u64 ticks, u32 length + raw args
+                         (version 1: i64 seconds and i32 nanoseconds instead of the ticks)
+*/
+
+#define ZLOG_BINARY_HEADER      'H'
+#define ZLOG_BINARY_SITE        'S'
+#define ZLOG_BINARY_CLOCK       'C'
+#define ZLOG_BINARY_MESSAGE     'R'
+#define ZLOG_BINARY_VERSION     2
+
+/*!
+    State of the binary mode
+
+    @param stream the binary file, NULL in text mode
+    @param lock the mutex taken to write a new callsite
+    @param session the number of times a binary file has been opened, the callsites cache their id for a session
+    @param next_id the id of the next callsite
+    @param clock the clock and the version of the last calibration written to the file, 0 for none
+*/
+typedef struct {
+
+    _Atomic(FILE*) stream;
+    LogMutex lock;
+    _Atomic(uint32_t) session;
+    uint32_t next_id;
+    _Atomic(uint64_t) clock;
+
+}LogBinaryOutput;
+
+static LogBinaryOutput zlog_binary = { NULL, ZLOG_MUTEX_INIT, 0, 0, 0 };
+
+static void zlog_binary_put_string(LogBuffer* buffer, const char* str, size_t size_bytes){
+
+    uint32_t length = (uint32_t)strlen(str);
+
+    if(size_bytes == 2){
+        uint16_t short_length = length > UINT16_MAX ? UINT16_MAX : (uint16_t)length;
+        zlog_buffer_append(buffer, (const char*)&short_length, sizeof(short_length));
+        length = short_length;
+    }else {
+        zlog_buffer_append(buffer, (const char*)&length, sizeof(length));
+    }
+
+    zlog_buffer_append(buffer, str, length);
+
+}
+
+/*!
+    Function that returns the format string kept by a callsite for the binary file, 
+    the first format written by the callsite is copied once and never replaced
+    @param site the callsite
+    @param fmt the format string of the record
+    @return 1 if the record has the format kept by the callsite, 0 otherwise
+*/
+
+static int zlog_binary_site_fmt(const LogCallsite* site, const char* fmt){
+
+    char *known = atomic_load_explicit(&site->cache->fmt, memory_order_acquire);
+
+    if(!known){
+
+        size_t length = strlen(fmt) + 1;
+        char *copy = (char*)zlog_malloc(length);
+        if(!copy) return 0;
+
+        memcpy(copy, fmt, length);
+
+        if(atomic_compare_exchange_strong_explicit(&site->cache->fmt, &known, copy, memory_order_acq_rel, memory_order_acquire)){
+            return 1;
+        }
+
+        zlog_free(copy);
+
+    }
+
+    return strcmp(known, fmt) == 0;
+
+}
+
+/*!
+    Function that returns the id of a callsite, the callsite is written to the binary file by its first call
+    and the id is cached on the callsite. The records with another format than the first one of the callsite 
+    write the callsite again with a new id
+    @param stream the binary file
+    @param site the callsite
+    @param fmt the format string of the record
+    @return the id of the callsite
+*/
+
+static uint32_t zlog_binary_site(FILE* stream, const LogCallsite* site, const char* fmt){
+
+    uint64_t session = atomic_load_explicit(&zlog_binary.session, memory_order_acquire);
+    uint64_t cached = atomic_load_explicit(&site->cache->binary, memory_order_acquire);
+    int known = zlog_binary_site_fmt(site, fmt);
+
+    if(known && (cached >> 32) == session) return (uint32_t)cached;
+
+    zlog_mutex_lock(&zlog_binary.lock);
+
+    cached = atomic_load_explicit(&site->cache->binary, memory_order_relaxed);
+
+    if(known && (cached >> 32) == session){
+        zlog_mutex_unlock(&zlog_binary.lock);
+        return (uint32_t)cached;
+    }
+
+    uint32_t id = ++zlog_binary.next_id;
+
+    LogBuffer buffer;
+    zlog_buffer_init(&buffer);
+
+    zlog_buffer_append(&buffer, (const char[]){ ZLOG_BINARY_SITE }, 1);
+    zlog_buffer_append(&buffer, (const char*)&id, sizeof(id));
+    zlog_buffer_append(&buffer, (const char*)&site->line, sizeof(site->line));
+    zlog_binary_put_string(&buffer, site->filename, 2);
+    zlog_binary_put_string(&buffer, site->fun_name, 2);
+    zlog_binary_put_string(&buffer, fmt, 4);
+
+    fwrite(buffer.data, 1, buffer.length, stream);
+    zlog_buffer_free(&buffer);
+
+    if(known) atomic_store_explicit(&site->cache->binary, (session << 32) | id, memory_order_release);
+
+    zlog_mutex_unlock(&zlog_binary.lock);
+
+    return id;
+
+}
+
+/*!
+    Function that writes the calibration of a clock to the binary file when it has changed since the last one written, 
+    so the decoder converts the ticks of the next messages
+    @param stream the binary file
+    @param clock the clock
+*/
+
+static void zlog_binary_clock(FILE* stream, LogClockSource clock){
+
+    LogClockCalibration calibration;
+    uint64_t key = ((uint64_t)clock << 56) | zlog_clock_calibration(clock, &calibration);
+
+    if(atomic_load_explicit(&zlog_binary.clock, memory_order_acquire) == key) return;
+
+    zlog_mutex_lock(&zlog_binary.lock);
+
+    key = ((uint64_t)clock << 56) | zlog_clock_calibration(clock, &calibration);
+
+    if(atomic_load_explicit(&zlog_binary.clock, memory_order_relaxed) != key){
+
+        LogBuffer buffer;
+        zlog_buffer_init(&buffer);
+
+        uint8_t clock8 = (uint8_t)clock;
+
+        zlog_buffer_append(&buffer, (const char[]){ ZLOG_BINARY_CLOCK }, 1);
+        zlog_buffer_append(&buffer, (const char*)&clock8, sizeof(clock8));
+        zlog_buffer_append(&buffer, (const char*)&calibration.ticks, sizeof(calibration.ticks));
+        zlog_buffer_append(&buffer, (const char*)&calibration.wall, sizeof(calibration.wall));
+        zlog_buffer_append(&buffer, (const char*)&calibration.scale, sizeof(calibration.scale));
+
+        fwrite(buffer.data, 1, buffer.length, stream);
+        zlog_buffer_free(&buffer);
+
+        atomic_store_explicit(&zlog_binary.clock, key, memory_order_release);
+
+    }
+
+    zlog_mutex_unlock(&zlog_binary.lock);
+
+}
+
+/*!
+    Function that starts a message of the binary file, the length of the raw args is written by zlog_binary_end()
+    @param buffer the buffer of the message
+    @param stream the binary file
+    @param site the callsite of the log
+    @param fmt the format string of the log
+    @param level the level of the log
+    @param clock the clock of the ticks
+    @param ticks the raw ticks of the log, converted by the decoder
+    @return the offset of the raw args in the buffer
+*/
+
+static size_t zlog_binary_begin(LogBuffer* buffer, FILE* stream, const LogCallsite* site, const char* fmt, LogLevel level, LogClockSource clock, uint64_t ticks){
+
+    uint32_t id = zlog_binary_site(stream, site, fmt);
+
+    zlog_binary_clock(stream, clock);
+
+    uint8_t level8 = (uint8_t)level;
+    uint32_t length = 0;
+
+    zlog_buffer_append(buffer, (const char[]){ ZLOG_BINARY_MESSAGE }, 1);
+    zlog_buffer_append(buffer, (const char*)&id, sizeof(id));
+    zlog_buffer_append(buffer, (const char*)&level8, sizeof(level8));
+    zlog_buffer_append(buffer, (const char*)&ticks, sizeof(ticks));
+    zlog_buffer_append(buffer, (const char*)&length, sizeof(length));
+
+    return buffer->length;
+
+}
+
+/*!
+    Function that ends a message of the binary file and writes it
+    @param buffer the buffer of the message
+    @param stream the binary file
+    @param start the offset of the raw args returned by zlog_binary_begin()
+    @param time the timestamp of the message
+*/
+
+static void zlog_binary_end(LogBuffer* buffer, FILE* stream, size_t start, const struct timespec* time){
+
+    uint32_t length = (uint32_t)(buffer->length - start);
+    memcpy(buffer->data + start - sizeof(length), &length, sizeof(length));
+
+    if(atomic_load_explicit(&zlog_async.running, memory_order_relaxed) && buffer->length <= ZLOG_ASYNC_SLOT_SIZE){
+        LogSink sink = { stream, L_TRACE, 0, 0, NULL };
+        zlog_async_submit(&zlog, &sink, buffer->data, buffer->length, time);
+    }else {
+        fwrite(buffer->data, 1, buffer->length, stream);
+    }
+
+}
+
+/*!
+    Function that writes a message to the binary file without formatting it
+    @param stream the binary file
+    @param site the callsite of the log
+    @param fmt the format string of the message
+    @param level the level of the log
+    @param args the args of the message
+*/
+
+static void zlog_binary_write(FILE* stream, const LogCallsite* site, const char* fmt, LogLevel level, va_list args){
+
+    LogClockSource clock = atomic_load_explicit(&zlog.clock, memory_order_relaxed);
+    uint64_t ticks = zlog_clock_ticks(clock);
+    struct timespec ts = zlog_clock_wall(clock, ticks);
+
+    LogBuffer buffer;
+    zlog_buffer_init_arena(&buffer, &zlog_arenas[0]);
+
+    size_t start = zlog_binary_begin(&buffer, stream, site, fmt, level, clock, ticks);
+    zlog_args_encode(&buffer, fmt, args);
+    zlog_binary_end(&buffer, stream, start, &ts);
+
+    zlog_buffer_free(&buffer);
+
+}
+
+int zlog_binary_open(const char* path){
+
+    const char *mode = atomic_load(&zlog.mode)[0] == 'w' ? "wb" : "ab";
+    FILE *stream = fopen(path, mode);
+
+    if(!stream){
+        fprintf(stderr, "[ERROR] Couldn't open file: %s\n", path);
+        return -1;
+    }
+
+    zlog_binary_close();
+
+    zlog_mutex_lock(&zlog_binary.lock);
+
+    atomic_fetch_add(&zlog_binary.session, 1);
+    zlog_binary.next_id = 0;
+    atomic_store(&zlog_binary.clock, 0);
+
+    LogBuffer buffer;
+    zlog_buffer_init(&buffer);
+
+    uint16_t version = ZLOG_BINARY_VERSION;
+    uint16_t byte_order = 0x0102;
+    zlog_buffer_append(&buffer, (const char[]){ ZLOG_BINARY_HEADER }, 1);
+    zlog_buffer_append(&buffer, "ZLOG", 4);
+    zlog_buffer_append(&buffer, (const char*)&version, sizeof(version));
+    zlog_buffer_append(&buffer, (const char*)&byte_order, sizeof(byte_order));
+    zlog_binary_put_string(&buffer, zlog.name ? zlog.name : "", 2);
+
+    zlog_read_begin();
+    zlog_binary_put_string(&buffer, atomic_load(&zlog.pattern), 2);
+    zlog_read_end();
+
+    fwrite(buffer.data, 1, buffer.length, stream);
+    zlog_buffer_free(&buffer);
+
+    atomic_store_explicit(&zlog_binary.stream, stream, memory_order_release);
+
+    zlog_mutex_unlock(&zlog_binary.lock);
+
+    return 0;
+
+}
+
+void zlog_binary_close(){
+
+    zlog_async_wait();
+
+    FILE *stream = atomic_exchange(&zlog_binary.stream, NULL);
+
+    if(stream) fclose(stream);
+
+}
+
+/*!
+    Function that pushes a record to the backtrace, overwriting the oldest one when the ring is full.
+    The format string and the path of the file are copied with the args, which are encoded before taking the lock, 
+    the storage of a slot is allocated again only when it grows
+    @param backtrace the ring
+    @param clock the clock of the logger
+    @param site the callsite of the log
+    @param output_file the file of a zflog record, NULL for the records written to the sinks of the logger
+    @param fmt the format string of the message
+    @param level the level of the log
+    @param args the args of the message
+*/
+
+static void zlog_backtrace_push(LogBacktrace* backtrace, LogClockSource clock, const LogCallsite* site, const char* output_file, const char* fmt, LogLevel level, va_list args){
+
+    uint64_t ticks = zlog_clock_ticks(clock);
+
+    LogBuffer buffer;
+    zlog_buffer_init_arena(&buffer, &zlog_arenas[0]);
+    zlog_buffer_append(&buffer, fmt, strlen(fmt) + 1);
+
+    size_t path = output_file ? buffer.length : 0;
+    if(output_file) zlog_buffer_append(&buffer, output_file, strlen(output_file) + 1);
+
+    size_t offset = buffer.length;
+    zlog_args_encode(&buffer, fmt, args);
+
+    zlog_mutex_lock(&backtrace->lock);
+
+    LogBacktraceEntry *entry = &backtrace->entries[backtrace->next];
+
+    if(!entry->args || entry->capacity < buffer.length){
+
+        size_t capacity = buffer.length > ZLOG_BACKTRACE_ARGS_SIZE ? buffer.length : ZLOG_BACKTRACE_ARGS_SIZE;
+        char *bigger = (char*)zlog_realloc(entry->args, capacity);
+
+        if(!bigger){
+            zlog_mutex_unlock(&backtrace->lock);
+            zlog_buffer_free(&buffer);
+            return;
+        }
+
+        entry->args = bigger;
+        entry->capacity = capacity;
+
+    }
+
+    entry->site = site;
+    entry->level = level;
+    entry->clock = clock;
+    entry->ticks = ticks;
+    entry->path = path;
+    entry->offset = offset;
+    entry->length = buffer.length;
+    memcpy(entry->args, buffer.data, buffer.length);
+
+    backtrace->next = (backtrace->next + 1) % backtrace->capacity;
+    if(backtrace->count < backtrace->capacity) backtrace->count++;
+
+    zlog_mutex_unlock(&backtrace->lock);
+
+    zlog_buffer_free(&buffer);
+
+}
+
+
+/*!
+    Prefix of a callsite: the fields that depend only on the callsite ({f}, {l}, {n}, {t}) and the literals 
+    of the pattern are rendered once and merged into spans, only the date, time, thread and cpu fields are left to render
+
+    @param pattern the id of the pattern the prefix has been rendered for, unique across the loggers
+    @param name the name of the logger the prefix has been rendered for
+    @param level the level the prefix has been rendered for
+    @param next the next prefix retired with the same pattern
+    @param count the number of instructions
+    @param ops the LITERAL instructions point to the rendered spans in text, the others are the fields rendered for every record
+    @param text the rendered spans
+*/
+typedef struct LogSitePrefix {
+
+    uint64_t pattern;
+    const char * name;
+    LogLevel level;
+    struct LogSitePrefix * next;
+    size_t count;
+    PatternOp ops[ZLOG_PATTERN_MAX_OPS];
+    char text[];
+
+}LogSitePrefix;
+
+/*!
+    Function that renders the prefix of a callsite
+    @param site the callsite
+    @param pattern the compiled pattern
+    @param name the name of the logger
+    @param level the level of the log
+    @param use_colors whether the prefix is rendered with colors
+    @return the prefix or NULL if the memory couldn't be allocated
+*/
+
+static LogSitePrefix* zlog_build_site_prefix(const LogCallsite* site, const CompiledPattern* pattern, const char* name, LogLevel level, int use_colors){
+
+    LogBuffer text;
+    zlog_buffer_init(&text);
+
+    PatternOp ops[ZLOG_PATTERN_MAX_OPS];
+    size_t count = 0;
+
+    for(size_t i = 0; i < pattern->count; i++){
+
+        const PatternOp *op = &pattern->ops[i];
+
+        if(ZLOG_IS_RECORD_FIELD(op->type)){
+            ops[count++] = *op;
+            continue;
+        }
+
+        size_t start = text.length;
+
+        if(use_colors) zlog_begin_color(&text, op->type, level);
+
+        switch(op->type){
+            case FUNCTION:
+                zlog_buffer_puts(&text, site->fun_name);
+                break;
+            case LOCATION:
+                zlog_buffer_append_location(&text, site->filename, site->line);
+                break;
+            case NAME:
+                zlog_buffer_puts(&text, name);
+                break;
+            case TAG:
+                zlog_buffer_append_tag(&text, level);
+                break;
+            case LITERAL:
+                zlog_buffer_append(&text, pattern->source + op->offset, op->length);
+                break;
+            default:
+                break;
+        }
+
+        if(use_colors) zlog_end_color(&text, op->type);
+
+        if(count > 0 && ops[count - 1].type == LITERAL){
+            ops[count - 1].length = (uint16_t)(text.length - ops[count - 1].offset);
+        }else {
+            ops[count].type = LITERAL;
+            ops[count].offset = (uint16_t)start;
+            ops[count].length = (uint16_t)(text.length - start);
+            count++;
+        }
+
+    }
+
+    LogSitePrefix *prefix = text.length <= UINT16_MAX ? (LogSitePrefix*)zlog_malloc(sizeof(LogSitePrefix) + text.length) : NULL;
+
+    if(prefix){
+        prefix->pattern = pattern->id;
+        prefix->name = name;
+        prefix->level = level;
+        prefix->next = NULL;
+        prefix->count = count;
+        memcpy(prefix->ops, ops, count * sizeof(PatternOp));
+        memcpy(prefix->text, text.data, text.length);
+    }
+
+    zlog_buffer_free(&text);
+
+    return prefix;
+
+}
+
+/*
+    List of the callsites that have filled a prefix, walked when a pattern is replaced to empty its slots
+*/
+
+static LogSiteCache *zlog_site_caches;
+static LogMutex zlog_site_caches_lock = ZLOG_MUTEX_INIT;
+
+/*!
+    Function that adds a callsite to the list of the callsites with prefixes, once
+    @param cache the cache of the callsite
+*/
+
+static void zlog_site_register(LogSiteCache* cache){
+
+    if(atomic_load_explicit(&cache->registered, memory_order_relaxed) || atomic_exchange(&cache->registered, 1)) return;
+
+    zlog_mutex_lock(&zlog_site_caches_lock);
+    cache->next = zlog_site_caches;
+    zlog_site_caches = cache;
+    zlog_mutex_unlock(&zlog_site_caches_lock);
+
+}
+
+/*!
+    Function that empties the slots of the callsites that hold a prefix of a replaced pattern and frees the prefixes 
+    once the log calls that may read them have returned.
+    It is called after the grace period of the replacement, so no log call renders the pattern anymore
+    @param pattern the id of the replaced pattern
+*/
+
+static void zlog_site_prefixes_retire(uint64_t pattern){
+
+    LogSitePrefix *retired = NULL;
+
+    zlog_mutex_lock(&zlog_site_caches_lock);
+
+    for(LogSiteCache *cache = zlog_site_caches; cache; cache = cache->next){
+        for(size_t i = 0; i < 2 * (L_FATAL + 1) * ZLOG_SITE_PREFIXES; i++){
+
+            _Atomic(LogSitePrefix*) *slot = &cache->prefix[0][0][0] + i;
+            LogSitePrefix *prefix = atomic_load_explicit(slot, memory_order_acquire);
+
+            if(prefix && prefix->pattern == pattern && atomic_compare_exchange_strong(slot, &prefix, NULL)){
+                prefix->next = retired;
+                retired = prefix;
+            }
+
+        }
+    }
+
+    zlog_mutex_unlock(&zlog_site_caches_lock);
+
+    if(!retired) return;
+
+    zlog_read_synchronize();
+
+    while(retired){
+        LogSitePrefix *next = retired->next;
+        zlog_free(retired);
+        retired = next;
+    }
+
+}
+
+/*!
+    Function that returns the prefix of a callsite for a level, pattern and logger, it is rendered by the first call 
+    that finds an empty slot. The prefixes of a replaced pattern are freed by zlog_site_prefixes_retire()
+    @param site the callsite
+    @param pattern the compiled pattern
+    @param name the name of the logger
+    @param level the level of the log
+    @param use_colors whether the prefix is rendered with colors
+    @return the prefix, or NULL if the slots hold the prefixes of other patterns or the memory couldn't be allocated
+*/
+
+static const LogSitePrefix* zlog_site_prefix(const LogCallsite* site, const CompiledPattern* pattern, const char* name, LogLevel level, int use_colors){
+
+    _Atomic(LogSitePrefix*) *slots = site->cache->prefix[use_colors ? 1 : 0][level];
+    _Atomic(LogSitePrefix*) *empty = NULL;
+
+    for(size_t i = 0; i < ZLOG_SITE_PREFIXES; i++){
+
+        LogSitePrefix *prefix = atomic_load_explicit(&slots[i], memory_order_acquire);
+
+        if(!prefix){
+            if(!empty) empty = &slots[i];
+        }else if(prefix->pattern == pattern->id && prefix->name == name){
+            return prefix;
+        }
+
+    }
+
+    if(!empty) return NULL;
+
+    LogSitePrefix *built = zlog_build_site_prefix(site, pattern, name, level, use_colors);
+    if(!built) return NULL;
+
+    LogSitePrefix *prefix = NULL;
+
+    if(atomic_compare_exchange_strong_explicit(empty, &prefix, built, memory_order_acq_rel, memory_order_acquire)){
+        zlog_site_register(site->cache);
+        return built;
+    }
+
+    zlog_free(built);
+
+    return prefix->pattern == pattern->id && prefix->name == name ? prefix : NULL;
+
+}
+
+/*!
+    Function that renders the prefix of a callsite at the start of the record
+    @param buffer the buffer of the record
+    @param prefix the prefix of the callsite
+    @param time the time of the log
+    @param use_colors whether the fields rendered for every record are colored
+    @param utc whether the date and the time are rendered in UTC
+*/
+
+static void zlog_render_site_prefix(LogBuffer* buffer, const LogSitePrefix* prefix, const struct timespec* time, int use_colors, int utc){
+
+    const LogTimeCache *time_fields = zlog_time_fields(time->tv_sec, utc);
+
+    for(size_t i = 0; i < prefix->count; i++){
+
+        const PatternOp *op = &prefix->ops[i];
+
+        if(op->type == LITERAL){
+            zlog_buffer_append(buffer, prefix->text + op->offset, op->length);
+            continue;
+        }
+
+        if(use_colors) zlog_begin_color(buffer, op->type, prefix->level);
+        zlog_buffer_append_field(buffer, op->type, time_fields, time->tv_nsec);
+        if(use_colors) zlog_buffer_puts(buffer, ANSI_COLOR_RESET);
+
+    }
+
+}
+
+/*!
+    Function that writes a rendered record to a sink with a single write, or pushes it to the queue in asynchronous mode
+    @param logger the logger of the record, its overflow policy is applied when the ring of the thread is full
+    @param sink the sink where the record is written
+    @param buffer the rendered record
+    @param time the time of the record, used to merge the rings of the threads in asynchronous mode
+*/
+
+static void zlog_write_output(zlogger* logger, const LogSink* sink, const LogBuffer* buffer, const struct timespec* time){
+
+    if(atomic_load_explicit(&zlog_async.running, memory_order_relaxed) && buffer->length <= ZLOG_ASYNC_SLOT_SIZE){
+        zlog_async_submit(logger, sink, buffer->data, buffer->length, time);
+    }else {
+        zlog_sink_write(sink, buffer->data, buffer->length);
+    }
+
+}
+
+/*!
+    Function that renders the prefix of a record
+    @param buffer the buffer of the record
+    @param site the callsite of the log
+    @param pattern the compiled pattern
+    @param name the name of the logger
+    @param level the level of the log
+    @param time the time of the log
+    @param use_colors whether the prefix is rendered with colors
+    @param utc whether the date and the time are rendered in UTC
+*/
+
+static void zlog_render_prefix(LogBuffer* buffer, const LogCallsite* site, const CompiledPattern* pattern, const char* name, LogLevel level, const struct timespec* time, int use_colors, int utc){
+
+    const LogSitePrefix *prefix = zlog_site_prefix(site, pattern, name, level, use_colors);
+
+    if(prefix){
+        zlog_render_site_prefix(buffer, prefix, time, use_colors, utc);
+    }else {
+        zlog_log_pattern(buffer, pattern, name, level, time, site->filename, site->fun_name, site->line, use_colors, utc);
+    }
+
+}
+
+/*!
+    Function that renders a record and writes it to every sink that accepts its level.
+    The message is formatted once, the colored variant of the record is rendered only if a sink needs it
+    @param logger the logger
+    @param sinks the sinks
+    @param count the number of sinks
+    @param site the callsite of the log
+    @param fmt the format string of the record
+    @param level the level of the log
+    @param entry the record of the backtrace that is written, NULL for a new record
+    @param args the args used to format the string of a new record
+*/
+
+static void zlog_write_record(zlogger* logger, const LogSink* sinks, size_t count, const LogCallsite* site, const char* fmt, LogLevel level, const LogBacktraceEntry* entry, va_list* args){
+
+    int use_colors = ZLOG_CHECK_FLAG(logger, ZLOG_BIT_USE_COLORS);
+    int utc = ZLOG_CHECK_FLAG(logger, ZLOG_BIT_USE_UTC);
+    int needed[2] = { 0, 0 };
+
+    for(size_t i = 0; i < count; i++){
+        if(level >= sinks[i].min_level) needed[use_colors && sinks[i].use_colors] = 1;
+    }
+
+    if(!needed[0] && !needed[1]) return;
+
+    const CompiledPattern *pattern = atomic_load(&logger->compiled);
+    struct timespec time;
+
+    if(entry){
+        time = zlog_clock_wall(entry->clock, entry->ticks);
+    }else if(pattern->precise || atomic_load_explicit(&zlog_async.running, memory_order_relaxed)){
+        time = zlog_clock_now(atomic_load_explicit(&logger->clock, memory_order_relaxed));
+    }else {
+        time = (struct timespec){ zlog_clock_seconds(), 0 };
+    }
+
+    LogBuffer records[2];
+    int first = needed[0] ? 0 : 1;
+
+    zlog_buffer_init_arena(&records[first], &zlog_arenas[first]);
+    zlog_render_prefix(&records[first], site, pattern, logger->name, level, &time, first, utc);
+
+    size_t body = records[first].length;
+
+    if(entry){
+        zlog_args_decode(&records[first], fmt, entry->args + entry->offset, entry->length - entry->offset);
+    }else {
+        zlog_buffer_vprintf(&records[first], fmt, *args);
+    }
+
+    if(first == 0 && needed[1]){
+        zlog_buffer_init_arena(&records[1], &zlog_arenas[1]);
+        zlog_render_prefix(&records[1], site, pattern, logger->name, level, &time, 1, utc);
+        zlog_buffer_append(&records[1], records[0].data + body, records[0].length - body);
+    }
+
+    for(size_t i = 0; i < count; i++){
+        if(level >= sinks[i].min_level){
+            zlog_write_output(logger, &sinks[i], &records[use_colors && sinks[i].use_colors], &time);
+        }
+    }
+
+    zlog_buffer_free(&records[first]);
+    if(first == 0 && needed[1]) zlog_buffer_free(&records[1]);
+
+}
+
+/*!
+    Function that writes the records of the backtrace to the sinks of the logger, 
+    or to the binary file in binary mode, from the oldest to the newest, and empties the ring. 
+    The records of the zflog macros are written to their file
+    @param logger the logger
+    @param backtrace the ring of the logger
+*/
+
+static void zlog_backtrace_dump(zlogger* logger, LogBacktrace* backtrace){
+
+    zlog_mutex_lock(&backtrace->lock);
+
+    FILE *binary = logger == &zlog ? atomic_load_explicit(&zlog_binary.stream, memory_order_acquire) : NULL;
+    const LogSinkList *sinks = atomic_load(&logger->sinks);
+    size_t first = (backtrace->next + backtrace->capacity - backtrace->count) % backtrace->capacity;
+
+    for(size_t i = 0; i < backtrace->count; i++){
+
+        const LogBacktraceEntry *entry = &backtrace->entries[(first + i) % backtrace->capacity];
+
+        if(entry->path){
+            FILE *stream = zlog_file_sink(entry->args + entry->path);
+            LogSink sink = { stream, L_TRACE, 0, 0, NULL };
+            if(stream) zlog_write_record(logger, &sink, 1, entry->site, entry->args, entry->level, entry, NULL);
+        }else if(binary){
+            LogBuffer buffer;
+            zlog_buffer_init_arena(&buffer, &zlog_arenas[0]);
+
+            struct timespec time = zlog_clock_wall(entry->clock, entry->ticks);
+
+            size_t start = zlog_binary_begin(&buffer, binary, entry->site, entry->args, entry->level, entry->clock, entry->ticks);
+            zlog_buffer_append(&buffer, entry->args + entry->offset, entry->length - entry->offset);
+            zlog_binary_end(&buffer, binary, start, &time);
+
+            zlog_buffer_free(&buffer);
+        }else {
+            zlog_write_record(logger, sinks->sinks, sinks->count, entry->site, entry->args, entry->level, entry, NULL);
+        }
+
+    }
+
+    backtrace->count = 0;
+    backtrace->next = 0;
+
+    zlog_mutex_unlock(&backtrace->lock);
+
+}
+
+void zlogger_dump_backtrace(zlogger* logger){
+
+    zlog_read_begin();
+
+    LogBacktrace *backtrace = atomic_load(&logger->backtrace);
+    if(backtrace) zlog_backtrace_dump(logger, backtrace);
+
+    zlog_read_end();
+
+}
+
+/*!
+    Function that checks whether a record is written to the sinks of a logger: its level is not below 
+    the minimum level and the debug records are written only with the ZLOG_DEBUG flag
+    @param logger the logger
+    @param level the level of the record
+    @return 1 if the record is written, 0 otherwise
+*/
+
+static int zlog_level_logged(zlogger* logger, LogLevel level){
+
+    return level >= atomic_load_explicit(&logger->min_level, memory_order_relaxed) &&
+           (level != L_DEBUG || ZLOG_CHECK_FLAG(logger, ZLOG_BIT_DEBUG));
+
+}
+
+/*
+    Seconds between two summaries of the records dropped by a logger
+*/
+
+#ifndef ZLOG_DROP_REPORT_SECONDS
+#define ZLOG_DROP_REPORT_SECONDS 1
+#endif
+
+#define ZLOG_DROP_REPORT_FORMAT "%llu records dropped, the asynchronous ring was full\n"
+
+/*!
+    Function that logs a warning with the number of records the logger has dropped since the last summary, 
+    at most once every ZLOG_DROP_REPORT_SECONDS. The warning bypasses the minimum level of the logger, 
+    so the records counted as reported are always written
+    @param logger the logger
+*/
+
+static void zlog_report_drops(zlogger* logger){
+
+    uint64_t dropped = atomic_load_explicit(&logger->dropped, memory_order_relaxed);
+
+    if(dropped == atomic_load_explicit(&logger->reported, memory_order_relaxed)) return;
+
+    int64_t now = (int64_t)zlog_clock_seconds();
+    int64_t last = atomic_load_explicit(&logger->report_time, memory_order_relaxed);
+
+    if(now - last < ZLOG_DROP_REPORT_SECONDS ||
+       !atomic_compare_exchange_strong_explicit(&logger->report_time, &last, now, memory_order_relaxed, memory_order_relaxed)){
+        return;
+    }
+
+    uint64_t reported = atomic_exchange_explicit(&logger->reported, dropped, memory_order_relaxed);
+    if(dropped <= reported) return;
+
+    ZLOG_CALLSITE(L_WARNING);
+
+    zlog_reporting_drops = 1;
+    zlog_(logger, &zlog_site_, L_WARNING, ZLOG_DROP_REPORT_FORMAT, (unsigned long long)(dropped - reported));
+    zlog_reporting_drops = 0;
+
+}
+
+/*!
+    Function that returns the backtrace used by a record, called between zlog_read_begin() and zlog_read_end()
+    @param logger the logger of the record
+    @param logged whether the record is written
+    @param level the level of the record
+    @return the ring where the record is pushed if it is not written, the ring written before an error or a fatal record, 
+            NULL otherwise or if the backtrace is disabled
+*/
+
+static LogBacktrace* zlog_record_backtrace(zlogger* logger, int logged, LogLevel level){
+
+    if(logged && level < L_ERROR) return NULL;
+
+    LogBacktrace *backtrace = atomic_load(&logger->backtrace);
+
+    return backtrace && atomic_load_explicit(&backtrace->enabled, memory_order_relaxed) ? backtrace : NULL;
+
+}
+
+void zlog_(zlogger* logger, const LogCallsite* site, LogLevel level, const char* fmt, ...){
+    
+    /* the summary of the dropped records is written whatever the minimum level of the logger */
+    int logged = zlog_reporting_drops || zlog_level_logged(logger, level);
+
+    if(!logged && !atomic_load_explicit(&logger->backtrace, memory_order_relaxed)) return;
+
+    zlog_read_begin();
+
+    LogBacktrace *backtrace = zlog_record_backtrace(logger, logged, level);
+
+    va_list arg_ptr;
+    va_start(arg_ptr, fmt);
+
+    if(!logged){
+
+        if(backtrace) zlog_backtrace_push(backtrace, atomic_load_explicit(&logger->clock, memory_order_relaxed), site, NULL, fmt, level, arg_ptr);
+
+    }else {
+
+        if(backtrace) zlog_backtrace_dump(logger, backtrace);
+
+        FILE *binary = logger == &zlog ? atomic_load_explicit(&zlog_binary.stream, memory_order_acquire) : NULL;
+
+        if(binary){
+            zlog_binary_write(binary, site, fmt, level, arg_ptr);
+        }else {
+            const LogSinkList *sinks = atomic_load(&logger->sinks);
+            zlog_write_record(logger, sinks->sinks, sinks->count, site, fmt, level, NULL, &arg_ptr);
+        }
+
+    }
+
+    va_end(arg_ptr);
+
+    zlog_read_end();
+
+    if(logged) zlog_report_drops(logger);
+    
+}
+
+void zflog_(const char* output_file, const LogCallsite* site, LogLevel level, const char* fmt, ...){
+
+    int logged = zlog_level_logged(&zlog, level);
+
+    if(!logged && !atomic_load_explicit(&zlog.backtrace, memory_order_relaxed)) return;
+
+    zlog_read_begin();
+
+    LogBacktrace *backtrace = zlog_record_backtrace(&zlog, logged, level);
+
+    va_list arg_ptr;
+    va_start(arg_ptr, fmt);
+
+    if(!logged){
+
+        if(backtrace) zlog_backtrace_push(backtrace, atomic_load_explicit(&zlog.clock, memory_order_relaxed), site, output_file, fmt, level, arg_ptr);
+
+    }else {
+
+        if(backtrace) zlog_backtrace_dump(&zlog, backtrace);
+
+        FILE *stream = zlog_file_sink(output_file);
+        LogSink sink = { stream, L_TRACE, 0, 0, NULL };
+
+        if(stream) zlog_write_record(&zlog, &sink, 1, site, fmt, level, NULL, &arg_ptr);
+
+    }
+
+    va_end(arg_ptr);
+
+    zlog_read_end();
+
+    if(logged) zlog_report_drops(&zlog);
 
-    va_list arg_ptr;
-    va_start(arg_ptr, fmt);
-    vfprintf(zlog.Stream, fmt, arg_ptr);
-    va_end(arg_ptr);
-    
 }
 
 #endif /* ZLOG_IMPLEMENTATION */
\ No newline at end of file
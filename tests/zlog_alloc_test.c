@@ -0,0 +1,98 @@
+/*
+    zlog_alloc_test: checks that the log calls don't allocate in the steady state.
+
+    A callsite allocates only for the first record of every level it logs, the next records are rendered
+    in the arenas of the thread. The check runs 1000 rounds where a zlog() callsite alternates between two levels
+    and a helper alternates between two loggers, and fails if zlog_allocation_count() changes.
+    The pattern is then replaced: the callsites must render the prefixes of the new pattern again, 
+    and the next 1000 rounds must not allocate either.
+*/
+
+#define ZLOG_IMPLEMENTATION
+#include "../src/zLog.h"
+
+#include <stdio.h>
+
+#define TEST_ROUNDS 1000
+
+static void log_request(zlogger* logger, int id){
+    zlogger_info(logger, "Request %d served\n", id);
+}
+
+static void log_current(int id){
+    zlog("Request %d at the current level\n", id);
+}
+
+static void log_round(zlogger* other, int round){
+
+    zlog.set_level(round % 2 ? L_WARNING : L_INFO);
+    log_current(round);
+    log_request(round % 2 ? other : &zlog, round);
+
+}
+
+int main(void){
+
+    zlog_init("zlogger");
+
+    zlogger *other = zlog_create("other", NULL);
+
+    if(!other){
+        fprintf(stderr, "[ERROR] Couldn't create the logger\n");
+        return 1;
+    }
+
+    FILE *stream = tmpfile();
+
+    if(!stream){
+        fprintf(stderr, "[ERROR] Couldn't open a temporary file\n");
+        return 1;
+    }
+
+    zlog.set_output_stream(stream);
+    zlogger_set_output_stream(other, stream);
+
+    for(int i = 0; i < 2; i++) log_round(other, i);
+
+    size_t before = zlog_allocation_count();
+
+    for(int i = 0; i < TEST_ROUNDS; i++) log_round(other, i);
+
+    size_t allocations = zlog_allocation_count() - before;
+    int cached = 1;
+
+    if(allocations == 0 && zlog.set_pattern("{t} {f} @ {l} > ") == 0){
+
+        before = zlog_allocation_count();
+
+        for(int i = 0; i < 2; i++) log_round(other, i);
+
+        /* the slots of the replaced pattern are emptied, the new prefixes are rendered once */
+        cached = zlog_allocation_count() != before;
+        before = zlog_allocation_count();
+
+        for(int i = 0; i < TEST_ROUNDS; i++) log_round(other, i);
+
+        allocations = zlog_allocation_count() - before;
+
+    }
+
+    zlog.set_output_stream(stdout);
+    zlog_destroy(other);
+    fclose(stream);
+
+    if(allocations != 0){
+        fprintf(stderr, "[ERROR] %zu allocations in the steady state\n", allocations);
+        return 1;
+    }
+
+    if(!cached){
+        fprintf(stderr, "[ERROR] The prefixes of the new pattern are not cached\n");
+        return 1;
+    }
+
+    printf("no allocation in %d rounds\n", TEST_ROUNDS);
+
+    return 0;
+
+}
@@ -0,0 +1,130 @@
+/*
+    zlog_backtrace_test: checks that the zflog records go through the backtrace of the default logger.
+
+    With the minimum level at WARNING and the backtrace enabled, a zflog_debug() record is kept in the ring
+    instead of being written to its file, and a zflog_error() writes the ring before its own record:
+    the zflog record to its file and the zlog_debug() record to the stream of the logger.
+*/
+
+#define ZLOG_IMPLEMENTATION
+#include "../src/zLog.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_FILE "zlog_backtrace_test.log"
+#define TEST_BACKTRACE 8
+
+/*!
+    Function that reads a file in a static buffer
+    @param path the path of the file
+    @return the content of the file, an empty string if it can't be read
+*/
+
+static const char* read_file(const char* path){
+
+    static char content[4096];
+    content[0] = '\0';
+
+    FILE *file = fopen(path, "r");
+    if(!file) return content;
+
+    size_t length = fread(content, 1, sizeof(content) - 1, file);
+    content[length] = '\0';
+    fclose(file);
+
+    return content;
+
+}
+
+/*!
+    Function that checks that a text is in a content, before another text if it's given
+    @param content the content
+    @param text the text that must be found
+    @param before the text that must follow it, or NULL
+    @return 0 if the check passes, -1 otherwise
+*/
+
+static int check(const char* content, const char* text, const char* before){
+
+    const char *found = strstr(content, text);
+
+    if(!found || (before && (!strstr(content, before) || strstr(content, before) < found))){
+        fprintf(stderr, "[ERROR] \"%s\" not found%s%s\n", text, before ? " before " : "", before ? before : "");
+        return -1;
+    }
+
+    return 0;
+
+}
+
+int main(void){
+
+    zlog_init("zlogger");
+
+    FILE *stream = tmpfile();
+
+    if(!stream){
+        fprintf(stderr, "[ERROR] Couldn't open a temporary file\n");
+        return 1;
+    }
+
+    zlog.set_output_stream(stream);
+    zlog.set_min_level(L_WARNING);
+    remove(TEST_FILE);
+
+    int result = zlog.enable_backtrace(TEST_BACKTRACE);
+
+    if(result != 0) fprintf(stderr, "[ERROR] Couldn't enable the backtrace\n");
+
+    if(result == 0){
+
+        zflog_debug(TEST_FILE, "kept file record\n");
+        zlog_debug("kept stream record\n");
+        zlog.close_files();
+
+        if(strstr(read_file(TEST_FILE), "kept file record")){
+            fprintf(stderr, "[ERROR] The zflog record below the minimum level was written before the error\n");
+            result = -1;
+        }
+
+    }
+
+    if(result == 0){
+
+        zflog_error(TEST_FILE, "file error\n");
+        zlog.close_files();
+
+        result = check(read_file(TEST_FILE), "kept file record", "file error");
+
+    }
+
+    if(result == 0){
+
+        fflush(stream);
+        rewind(stream);
+
+        static char content[4096];
+        size_t length = fread(content, 1, sizeof(content) - 1, stream);
+        content[length] = '\0';
+
+        result = check(content, "kept stream record", NULL);
+
+        if(result == 0 && strstr(content, "kept file record")){
+            fprintf(stderr, "[ERROR] The zflog record was written to the stream of the logger\n");
+            result = -1;
+        }
+
+    }
+
+    zlog.set_output_stream(stdout);
+    fclose(stream);
+    remove(TEST_FILE);
+
+    if(result != 0) return 1;
+
+    printf("zflog records kept in the backtrace and written by an error\n");
+
+    return 0;
+
+}
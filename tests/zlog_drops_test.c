@@ -0,0 +1,71 @@
+/*
+    zlog_drops_test: checks that the summary of the dropped records is written above the minimum level of the logger.
+
+    The logger writes only the errors, in asynchronous mode with a ring of 2 records and the ZLOG_OVERFLOW_DROP policy.
+    The test logs errors until some are dropped and fails if the "records dropped" warning is not in the output.
+*/
+
+#define ZLOG_DROP_REPORT_SECONDS 0
+
+#define ZLOG_IMPLEMENTATION
+#include "../src/zLog.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_RECORDS 100000
+
+int main(void){
+
+    zlog_init("zlogger");
+
+    FILE *stream = tmpfile();
+
+    if(!stream){
+        fprintf(stderr, "[ERROR] Couldn't open a temporary file\n");
+        return 1;
+    }
+
+    zlog.set_output_stream(stream);
+    zlog.set_min_level(L_ERROR);
+
+    if(zlog.set_overflow_policy(ZLOG_OVERFLOW_DROP) != 0 || zlog_async_init(2) != 0 || zlog_async_start() != 0){
+        fprintf(stderr, "[ERROR] Couldn't start the asynchronous mode\n");
+        return 1;
+    }
+
+    for(int i = 0; i < TEST_RECORDS && zlog.get_async_stats().dropped == 0; i++) zlog_error("error %d\n", i);
+
+    /* the summary is written by the next log call */
+    zlog_error("last error\n");
+
+    zlog_async_stop();
+
+    uint64_t dropped = zlog.get_async_stats().dropped;
+
+    fflush(stream);
+    rewind(stream);
+
+    static char line[1024];
+    int found = 0;
+
+    while(!found && fgets(line, sizeof(line), stream)) found = strstr(line, "records dropped") != NULL;
+
+    zlog.set_output_stream(stdout);
+    fclose(stream);
+
+    if(dropped == 0){
+        fprintf(stderr, "[ERROR] No record dropped in %d records\n", TEST_RECORDS);
+        return 1;
+    }
+
+    if(!found){
+        fprintf(stderr, "[ERROR] The summary of the %llu dropped records is missing\n", (unsigned long long)dropped);
+        return 1;
+    }
+
+    printf("summary of the dropped records written with the minimum level at L_ERROR\n");
+
+    return 0;
+
+}
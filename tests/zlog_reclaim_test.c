@@ -0,0 +1,176 @@
+/*
+    zlog_reclaim_test: changes the sinks, the pattern and the backtrace of the logger and closes the zflog files while other threads are logging.
+
+    Usage: zlog_reclaim_test [changes]
+
+    TEST_THREADS threads log to the default logger and to a zflog file while the main thread adds and removes a file sink, 
+    changes the level of a stream sink, the pattern and the capacity of the backtrace and closes the zflog files in a loop, 
+    first in synchronous mode and then in asynchronous mode.
+    The replaced sink lists, patterns and rings and the closed files are freed after a grace period, build the test with 
+    -fsanitize=address or -fsanitize=thread to check that no thread reads them once they are freed.
+    The allocations of the library are counted: the test fails if the loop leaves more blocks allocated than a warm-up run.
+*/
+
+#include <stdlib.h>
+#include <stdatomic.h>
+
+static atomic_long live_blocks;
+
+static void* test_malloc(size_t size){
+
+    void *ptr = malloc(size);
+    if(ptr) atomic_fetch_add(&live_blocks, 1);
+
+    return ptr;
+
+}
+
+static void* test_realloc(void* ptr, size_t size){
+
+    void *bigger = realloc(ptr, size);
+    if(bigger && !ptr) atomic_fetch_add(&live_blocks, 1);
+
+    return bigger;
+
+}
+
+static void test_free(void* ptr){
+
+    if(ptr) atomic_fetch_sub(&live_blocks, 1);
+    free(ptr);
+
+}
+
+#define ZLOG_MALLOC(size) test_malloc(size)
+#define ZLOG_REALLOC(ptr, size) test_realloc(ptr, size)
+#define ZLOG_FREE(ptr) test_free(ptr)
+
+#define ZLOG_IMPLEMENTATION
+#include "../src/zLog.h"
+
+#include <stdio.h>
+
+#define TEST_THREADS 4
+#define TEST_CHANGES 100
+#define TEST_FILE "zlog_reclaim_test.log"
+#define TEST_ZFLOG_FILE "zlog_reclaim_test_zflog.log"
+#define TEST_BACKTRACE 8
+
+static atomic_int started;
+static atomic_int stop;
+
+static ZLOG_THREAD_FN(log_loop){
+
+    (void)arg;
+
+    zlog_info("started\n");
+    atomic_fetch_add(&started, 1);
+
+    for(long i = 0; !atomic_load(&stop); i++){
+        zlog_info("record %ld\n", i);
+        zlog_warning("warning %ld\n", i);
+        zlog_debug("kept in the backtrace %ld\n", i);
+        if(i % 64 == 0) zlog_error("writes the backtrace %ld\n", i);
+        zflog_info(TEST_ZFLOG_FILE, "file record %ld\n", i);
+        zflog_debug(TEST_ZFLOG_FILE, "file record kept in the backtrace %ld\n", i);
+    }
+
+    return 0;
+
+}
+
+static int run(FILE* stream, int changes){
+
+    LogThread threads[TEST_THREADS];
+
+    atomic_store(&started, 0);
+    atomic_store(&stop, 0);
+
+    for(int i = 0; i < TEST_THREADS; i++){
+        if(zlog_thread_create(&threads[i], log_loop, NULL) != 0){
+            fprintf(stderr, "[ERROR] Couldn't create the threads\n");
+            return -1;
+        }
+    }
+
+    /* the changes start once every thread is logging */
+    while(atomic_load(&started) < TEST_THREADS) zlog_thread_yield();
+
+    int result = 0;
+
+    for(int i = 0; i < changes && result == 0; i++){
+        zlog.set_sink_level(stream, i % 2 ? L_WARNING : L_INFO);
+        result = zlog.add_file_sink(TEST_FILE, L_INFO);
+        zlog.remove_file_sink(TEST_FILE);
+        zlog.close_files();
+        if(result == 0) result = zlog.enable_backtrace(i % 2 ? TEST_BACKTRACE : 2 * TEST_BACKTRACE);
+        if(result == 0) result = zlog.set_pattern(i % 2 ? "{t} {f} > " : "{D}/{M}/{Y} {h}:{m}:{s}.{us} | {n} | {t} > ");
+    }
+
+    atomic_store(&stop, 1);
+
+    for(int i = 0; i < TEST_THREADS; i++) zlog_thread_join(threads[i]);
+
+    /* every run ends with a ring of the same capacity, so the runs leave the same blocks allocated */
+    if(result == 0) result = zlog.enable_backtrace(TEST_BACKTRACE);
+
+    if(result != 0) fprintf(stderr, "[ERROR] Couldn't add the file sink, set the pattern or enable the backtrace\n");
+
+    return result;
+
+}
+
+int main(int argc, char** argv){
+
+    int changes = argc > 1 ? atoi(argv[1]) : TEST_CHANGES;
+
+    zlog_init("zlogger");
+
+    FILE *stream = tmpfile();
+
+    if(!stream){
+        fprintf(stderr, "[ERROR] Couldn't open a temporary file\n");
+        return 1;
+    }
+
+    zlog.set_output_stream(stream);
+    zlog.set_min_level(L_INFO);
+
+    /* the warm-up run fills the caches of the callsites, which stay allocated */
+    int result = run(stream, 2);
+    long warm = atomic_load(&live_blocks);
+
+    if(result == 0) result = run(stream, changes);
+
+    if(result == 0){
+
+        if(zlog_async_init(1024) != 0 || zlog_async_start() != 0){
+            fprintf(stderr, "[ERROR] Couldn't start the asynchronous mode\n");
+            result = -1;
+        }else {
+            result = run(stream, changes);
+            zlog_async_stop();
+        }
+
+    }
+
+    long leaked = atomic_load(&live_blocks) - warm;
+
+    if(result == 0 && leaked > 0){
+        fprintf(stderr, "[ERROR] %ld blocks left allocated by the changes\n", leaked);
+        result = -1;
+    }
+
+    zlog.set_output_stream(stdout);
+    fclose(stream);
+    zlog.close_files();
+    remove(TEST_FILE);
+    remove(TEST_ZFLOG_FILE);
+
+    if(result != 0) return 1;
+
+    printf("%d changes of the sinks, the pattern and the backtrace while logging\n", changes);
+
+    return 0;
+
+}
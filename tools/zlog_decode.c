@@ -0,0 +1,428 @@
+/*
+    zlog-decode: turns the binary files written by zlog_binary_open() back into text.
+
+    Usage: zlog-decode [--colors] [--utc] [--pattern <pattern>] <file>...
+
+    Every message is rendered with the pattern stored in the file (or the one given with --pattern),
+    using the same format specifiers of the logger, in local time or in UTC with --utc. Use "-" to read from the standard input.
+    The files compressed by the rotation of a file sink (.zlz) are decompressed first, 
+    a compressed text file is written as it is.
+*/
+
+#define ZLOG_DECODER
+#define ZLOG_IMPLEMENTATION
+#include "../src/zLog.h"
+
+#include <stdio.h>
+
+/*!
+    Callsite read from the binary file
+*/
+typedef struct {
+
+    char * filename;
+    char * fun_name;
+    char * fmt;
+    uint32_t line;
+
+}DecodedSite;
+
+typedef struct {
+
+    DecodedSite * sites;
+    size_t count;
+    int use_colors;
+    int use_utc;
+    const char * pattern;
+    char * name;
+    uint16_t version;
+    LogClockCalibration clock;
+
+}Decoder;
+
+static void free_sites(Decoder* decoder){
+
+    for(size_t i = 0; i < decoder->count; i++){
+        free(decoder->sites[i].filename);
+        free(decoder->sites[i].fun_name);
+        free(decoder->sites[i].fmt);
+        memset(&decoder->sites[i], 0, sizeof(DecodedSite));
+    }
+
+}
+
+static char* read_all(FILE* stream, size_t* size){
+
+    size_t capacity = 1 << 16;
+    char *data = (char*)malloc(capacity);
+    *size = 0;
+
+    while(data){
+
+        size_t n = fread(data + *size, 1, capacity - *size, stream);
+        *size += n;
+
+        if(n == 0) break;
+
+        if(*size == capacity){
+            capacity *= 2;
+            char *bigger = (char*)realloc(data, capacity);
+            if(!bigger) free(data);
+            data = bigger;
+        }
+
+    }
+
+    return data;
+
+}
+
+/*!
+    Function that reads a number from the binary file
+    @param cursor the current position, moved after the number
+    @param end the end of the file
+    @param out the number
+    @param size the size of the number in bytes
+    @return 0 on success, -1 if the file is truncated
+*/
+
+static int read_bytes(const char** cursor, const char* end, void* out, size_t size){
+
+    if((size_t)(end - *cursor) < size) return -1;
+
+    memcpy(out, *cursor, size);
+    *cursor += size;
+
+    return 0;
+
+}
+
+static char* read_string(const char** cursor, const char* end, size_t size_bytes){
+
+    uint32_t length = 0;
+
+    if(size_bytes == 2){
+        uint16_t short_length;
+        if(read_bytes(cursor, end, &short_length, sizeof(short_length)) != 0) return NULL;
+        length = short_length;
+    }else if(read_bytes(cursor, end, &length, sizeof(length)) != 0){
+        return NULL;
+    }
+
+    if((size_t)(end - *cursor) < length) return NULL;
+
+    char *str = (char*)malloc(length + 1);
+    if(!str) return NULL;
+
+    memcpy(str, *cursor, length);
+    str[length] = '\0';
+    *cursor += length;
+
+    return str;
+
+}
+
+static int decode_header(Decoder* decoder, const char** cursor, const char* end){
+
+    char magic[4];
+    uint16_t version, byte_order;
+
+    if(read_bytes(cursor, end, magic, sizeof(magic)) != 0 || memcmp(magic, "ZLOG", 4) != 0 ||
+       read_bytes(cursor, end, &version, sizeof(version)) != 0 ||
+       read_bytes(cursor, end, &byte_order, sizeof(byte_order)) != 0){
+        fprintf(stderr, "[ERROR] Invalid header\n");
+        return -1;
+    }
+
+    if(byte_order != 0x0102){
+        fprintf(stderr, "[ERROR] The file has been written by a machine with a different byte order\n");
+        return -1;
+    }
+
+    if(version < 1 || version > ZLOG_BINARY_VERSION){
+        fprintf(stderr, "[ERROR] Unsupported version: %u\n", version);
+        return -1;
+    }
+
+    char *name = read_string(cursor, end, 2);
+    char *pattern = read_string(cursor, end, 2);
+
+    if(!name || !pattern){
+        free(name);
+        free(pattern);
+        return -1;
+    }
+
+    zlog_init(name);
+
+    /* zlog keeps the pointer to the name, the one of the previous header is freed once it is replaced */
+    free(decoder->name);
+    decoder->name = name;
+
+    if(zlog.set_pattern(decoder->pattern ? decoder->pattern : pattern) != 0){
+        free(pattern);
+        return -1;
+    }
+
+    free(pattern);
+    free_sites(decoder);
+
+    decoder->version = version;
+    decoder->clock = (LogClockCalibration){ 0, 0, ZLOG_CLOCK_UNIT_SCALE };
+
+    return 0;
+
+}
+
+static int decode_clock(Decoder* decoder, const char** cursor, const char* end){
+
+    uint8_t clock;
+    LogClockCalibration calibration;
+
+    if(read_bytes(cursor, end, &clock, sizeof(clock)) != 0 ||
+       read_bytes(cursor, end, &calibration.ticks, sizeof(calibration.ticks)) != 0 ||
+       read_bytes(cursor, end, &calibration.wall, sizeof(calibration.wall)) != 0 ||
+       read_bytes(cursor, end, &calibration.scale, sizeof(calibration.scale)) != 0){
+        return -1;
+    }
+
+    decoder->clock = calibration;
+
+    return 0;
+
+}
+
+static int decode_site(Decoder* decoder, const char** cursor, const char* end){
+
+    uint32_t id;
+    DecodedSite site;
+
+    if(read_bytes(cursor, end, &id, sizeof(id)) != 0 ||
+       read_bytes(cursor, end, &site.line, sizeof(site.line)) != 0){
+        return -1;
+    }
+
+    site.filename = read_string(cursor, end, 2);
+    site.fun_name = read_string(cursor, end, 2);
+    site.fmt = read_string(cursor, end, 4);
+
+    if(!site.filename || !site.fun_name || !site.fmt){
+        free(site.filename);
+        free(site.fun_name);
+        free(site.fmt);
+        return -1;
+    }
+
+    if(id >= decoder->count){
+
+        size_t count = (size_t)id + 1;
+        DecodedSite *sites = (DecodedSite*)realloc(decoder->sites, count * sizeof(DecodedSite));
+        if(!sites) return -1;
+
+        memset(sites + decoder->count, 0, (count - decoder->count) * sizeof(DecodedSite));
+
+        decoder->sites = sites;
+        decoder->count = count;
+
+    }
+
+    DecodedSite *slot = &decoder->sites[id];
+
+    free(slot->filename);
+    free(slot->fun_name);
+    free(slot->fmt);
+
+    *slot = site;
+
+    return 0;
+
+}
+
+static int decode_message(Decoder* decoder, const char** cursor, const char* end, LogBuffer* buffer){
+
+    uint32_t id, length;
+    uint8_t level;
+    struct timespec time;
+
+    if(read_bytes(cursor, end, &id, sizeof(id)) != 0 ||
+       read_bytes(cursor, end, &level, sizeof(level)) != 0){
+        return -1;
+    }
+
+    if(decoder->version == 1){
+
+        int64_t seconds;
+        int32_t nanoseconds;
+
+        if(read_bytes(cursor, end, &seconds, sizeof(seconds)) != 0 ||
+           read_bytes(cursor, end, &nanoseconds, sizeof(nanoseconds)) != 0){
+            return -1;
+        }
+
+        time.tv_sec = (time_t)seconds;
+        time.tv_nsec = (long)nanoseconds;
+
+    }else {
+
+        uint64_t ticks;
+
+        if(read_bytes(cursor, end, &ticks, sizeof(ticks)) != 0) return -1;
+
+        time = zlog_clock_convert(&decoder->clock, ticks);
+
+    }
+
+    if(read_bytes(cursor, end, &length, sizeof(length)) != 0 || (size_t)(end - *cursor) < length){
+        return -1;
+    }
+
+    if(id >= decoder->count || !decoder->sites[id].fmt || level > L_FATAL){
+        fprintf(stderr, "[ERROR] Message of an unknown callsite: %u\n", id);
+        *cursor += length;
+        return 0;
+    }
+
+    const DecodedSite *site = &decoder->sites[id];
+    const CompiledPattern *pattern = atomic_load(&zlog.compiled);
+
+    buffer->length = 0;
+
+    zlog_log_pattern(buffer, pattern, zlog.name, (LogLevel)level, &time, site->filename, site->fun_name, site->line, decoder->use_colors, decoder->use_utc);
+
+    if(zlog_args_decode(buffer, site->fmt, *cursor, length) != 0){
+        fprintf(stderr, "[ERROR] Truncated args of a message of %s:%u\n", site->filename, site->line);
+    }
+
+    *cursor += length;
+
+    fwrite(buffer->data, 1, buffer->length, stdout);
+
+    return 0;
+
+}
+
+static int decode_file(Decoder* decoder, const char* path){
+
+    FILE *stream = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+
+    if(!stream){
+        fprintf(stderr, "[ERROR] Couldn't open file: %s\n", path);
+        return -1;
+    }
+
+    size_t size;
+    char *data = read_all(stream, &size);
+
+    if(stream != stdin) fclose(stream);
+
+    if(!data){
+        fprintf(stderr, "[ERROR] Couldn't read file: %s\n", path);
+        return -1;
+    }
+
+    if(size >= 4 && memcmp(data, ZLOG_LZ_MAGIC, 4) == 0){
+
+        size_t decompressed_size;
+        char *decompressed = zlog_lz_decompress(data, size, &decompressed_size);
+
+        free(data);
+
+        if(!decompressed){
+            fprintf(stderr, "[ERROR] Corrupted compressed file: %s\n", path);
+            return -1;
+        }
+
+        if(decompressed_size < 5 || decompressed[0] != ZLOG_BINARY_HEADER || memcmp(decompressed + 1, "ZLOG", 4) != 0){
+            fwrite(decompressed, 1, decompressed_size, stdout);
+            free(decompressed);
+            return 0;
+        }
+
+        data = decompressed;
+        size = decompressed_size;
+
+    }
+
+    LogBuffer buffer;
+    zlog_buffer_init(&buffer);
+
+    const char *cursor = data;
+    const char *end = data + size;
+    int header = 0;
+    int result = 0;
+
+    while(cursor < end){
+
+        char type = *cursor++;
+        int status;
+
+        if(type == ZLOG_BINARY_HEADER){
+            status = decode_header(decoder, &cursor, end);
+            header = status == 0;
+        }else if(!header){
+            fprintf(stderr, "[ERROR] %s is not a zLog binary file\n", path);
+            status = -1;
+        }else if(type == ZLOG_BINARY_SITE){
+            status = decode_site(decoder, &cursor, end);
+        }else if(type == ZLOG_BINARY_CLOCK){
+            status = decode_clock(decoder, &cursor, end);
+        }else if(type == ZLOG_BINARY_MESSAGE){
+            status = decode_message(decoder, &cursor, end, &buffer);
+        }else {
+            fprintf(stderr, "[ERROR] Unknown record type 0x%02x at offset %zu\n", (unsigned char)type, (size_t)(cursor - data - 1));
+            status = -1;
+        }
+
+        if(status != 0){
+            fprintf(stderr, "[ERROR] Corrupted or truncated file: %s\n", path);
+            result = -1;
+            break;
+        }
+
+    }
+
+    zlog_buffer_free(&buffer);
+    free(data);
+
+    return result;
+
+}
+
+int main(int argc, char** argv){
+
+    Decoder decoder = { NULL, 0, 0, 0, NULL, NULL, 0, { 0, 0, ZLOG_CLOCK_UNIT_SCALE } };
+    int files = 0;
+    int result = 0;
+
+    for(int i = 1; i < argc; i++){
+
+        if(strcmp(argv[i], "--colors") == 0){
+            decoder.use_colors = 1;
+        }else if(strcmp(argv[i], "--utc") == 0){
+            decoder.use_utc = 1;
+        }else if(strcmp(argv[i], "--pattern") == 0 && i + 1 < argc){
+            decoder.pattern = argv[++i];
+        }else if(strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0){
+            files = 0;
+            break;
+        }else {
+            if(decode_file(&decoder, argv[i]) != 0) result = 1;
+            files++;
+        }
+
+    }
+
+    if(files == 0){
+        fprintf(stderr, "Usage: %s [--colors] [--utc] [--pattern <pattern>] <file>...\n", argv[0]);
+        return 1;
+    }
+
+    free_sites(&decoder);
+    free(decoder.sites);
+    free(decoder.name);
+
+    fflush(stdout);
+
+    return result;
+
+}